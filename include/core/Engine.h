@@ -5,6 +5,7 @@
 #include <string>
 #include "rendering/TextRenderer.h"
 #include "rendering/CRTShader.h"
+#include "rendering/FramePacer.h"
 #include "ui/Terminal.h"
 #include "ui/AsciiArt.h"
 #include "systems/CommandParser.h"
@@ -12,6 +13,7 @@
 #include "systems/SaveManager.h"
 #include "core/GameState.h"
 #include "core/Settings.h"
+#include "core/FrameScheduler.h"
 
 class CRTShader;
 
@@ -26,7 +28,20 @@ public:
     void Shutdown();
 
     void OnResize(int width, int height);
+    
+    // Fixed resolution the terminal is laid out and rendered at, scaled to
+    // the window by the CRT pass. 0 x 0 follows the window.
+    void SetVirtualResolution(unsigned int width, unsigned int height);
     void OnKeyPress(int key, int scancode, int action, int mods);
+
+    // When the main loop draws the next frame, and how it is paced
+    FrameScheduler& GetFrameScheduler() { return m_FrameScheduler; }
+    FramePacer& GetFramePacer() { return m_FramePacer; }
+
+    // The atlas is built once at startup, so a new glyph format is only
+    // stored and takes effect on the next launch
+    GlyphFormat GetGlyphFormat() const { return m_TextRenderer->GetGlyphFormat(); }
+    void SetGlyphFormat(GlyphFormat format);
     
     // Public save function for CommandParser access
     void SaveGameData();
@@ -36,6 +51,8 @@ public:
 private:
     unsigned int m_Width;
     unsigned int m_Height;
+    unsigned int m_VirtualWidth;   // 0 when following the window
+    unsigned int m_VirtualHeight;
 
     std::unique_ptr<TextRenderer> m_TextRenderer;
     std::unique_ptr<CRTShader> m_CRTShader;
@@ -47,6 +64,8 @@ private:
     std::unique_ptr<SaveManager> m_SaveManager;
     
     Settings m_Settings;
+    FrameScheduler m_FrameScheduler;
+    FramePacer m_FramePacer;
 
     bool m_IsBooting;
     float m_BootTimer;
@@ -0,0 +1,51 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+// Decides when the next frame is drawn. Nothing is drawn until something
+// asks for it: input, a terminal timer or a running animation. Frames are
+// never closer together than the target frame rate allows, and animation
+// alone drops to IDLE_FPS once there has been no input for IDLE_DELAY.
+// Times are in seconds on the glfwGetTime clock.
+class FrameScheduler {
+public:
+    static constexpr unsigned int MIN_FPS = 1;
+    static constexpr unsigned int MAX_FPS = 240;
+    static constexpr unsigned int IDLE_FPS = 10;
+    static constexpr double IDLE_DELAY = 5.0;
+
+    FrameScheduler();
+
+    void SetTargetFPS(unsigned int fps);
+    unsigned int GetTargetFPS() const { return m_TargetFPS; }
+
+    // Draw as soon as the frame rate allows
+    void RequestFrame() { m_Deadline = 0.0; }
+    // Draw at `time` at the latest
+    void RequestFrameAt(double time);
+    // Next frame of an animation nothing else is changing: as soon as the
+    // frame rate allows, or at IDLE_FPS when idle
+    void RequestAnimationFrame(double now);
+
+    // The user did something; animation runs at the full rate for a while
+    void OnInput(double now) { m_LastInput = now; }
+    bool IsIdle(double now) const { return now - m_LastInput >= IDLE_DELAY; }
+
+    // Seconds from `now` until the next frame is due: 0 or less if it is,
+    // infinity if nothing asked for one
+    double GetWaitTime(double now) const;
+
+    // A frame started at `now`; requests start over from here
+    void OnFrame(double now);
+
+    // Frames actually drawn per second, smoothed
+    double GetFrameRate() const { return m_FrameInterval > 0.0 ? 1.0 / m_FrameInterval : 0.0; }
+
+private:
+    unsigned int m_TargetFPS;
+    double m_Deadline;       // Latest time the next frame may start
+    double m_LastFrame;
+    double m_LastInput;
+    double m_FrameInterval;  // Smoothed time between frames
+};
+
+#endif // FRAMESCHEDULER_H
@@ -8,6 +8,10 @@ struct Settings {
     // Display settings
     glm::vec3 textColor;
     float typewriterSpeed;
+    unsigned int targetFPS;       // Frame rate cap; idle frames are skipped entirely
+    int swapInterval;             // Vblanks per swap, 0 swaps immediately
+    unsigned int framesInFlight;  // GPU queue limit, 0 leaves it to the driver
+    std::string glyphFormat;      // Atlas glyphs: bitmap, or sdf for scaled text. Read at startup
     
     // CRT settings
     bool crtEnabled;
@@ -16,7 +20,15 @@ struct Settings {
     float vignetteStrength;
     float chromaticAberration;
     float glowIntensity;
+    unsigned int glowPasses;      // Bloom mip chain length
+    unsigned int glowDownsample;  // Resolution divisor of the first bloom level
     float noiseAmount;
+    float persistence;            // Phosphor afterglow, 0 is off
+    std::string colorFormat;      // CRT render target format: rgba8, rgb10a2 or srgb
+    unsigned int virtualWidth;    // Fixed render resolution, 0 x 0 follows the window
+    unsigned int virtualHeight;
+    bool autoQuality;             // Let the governor pick the render scale
+    float renderScale;            // Manual render scale, used when autoQuality is off
     
     // Default values
     static Settings GetDefaults();
@@ -0,0 +1,67 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+#include <vector>
+#include "rendering/ShaderProgram.h"
+#include "rendering/RenderTargetPool.h"
+
+// Phosphor bloom for the CRT glow. The scene is bright-passed into the
+// first level of a mip chain, blurred down the chain with dual-Kawase
+// filtering and added back up, so a wide blur only ever touches a few
+// reduced-resolution targets. The levels come from the CRT pass's target
+// pool.
+class Bloom {
+public:
+    static constexpr unsigned int MAX_PASSES = 4;
+    static constexpr unsigned int MAX_DOWNSAMPLE = 16;  // Smallest level is 1/16
+
+    Bloom();
+    ~Bloom();
+
+    // `pool` must outlive the bloom. Fails only if the shaders don't build;
+    // see HasLevels for the targets.
+    bool Initialize(unsigned int width, unsigned int height, RenderTargetPool* pool);
+
+    // These rebuild the chain and return false, leaving it empty, if its
+    // targets can't be allocated
+    bool Resize(unsigned int width, unsigned int height);
+    // Number of chain levels, 1 to MAX_PASSES. Levels that would go below
+    // 1/MAX_DOWNSAMPLE resolution are dropped.
+    bool SetPasses(unsigned int passes);
+    // Resolution divisor of the first level: 2, 4, 8 or 16
+    bool SetDownsample(unsigned int divisor);
+    // Scene brightness above which pixels glow
+    void SetThreshold(float threshold) { m_Threshold = threshold; }
+
+    unsigned int GetPasses() const { return m_Passes; }
+    unsigned int GetDownsample() const { return m_Downsample; }
+    unsigned int GetLevelCount() const { return static_cast<unsigned int>(m_Levels.size()); }
+    bool HasLevels() const { return !m_Levels.empty(); }
+
+    // Blur `sourceTexture` and return the texture holding the result, at
+    // the first level's resolution, or 0 without levels. Leaves the
+    // framebuffer, viewport and blend state to the caller to restore.
+    unsigned int Render(unsigned int sourceTexture);
+
+private:
+    bool CreateLevels();
+    void ReleaseLevels();
+    void DrawLevel(const RenderTarget& target, ShaderProgram& shader, int halfPixelLocation);
+
+    ShaderProgram m_PrefilterShader;   // Bright-pass + first downsample
+    ShaderProgram m_DownsampleShader;
+    ShaderProgram m_UpsampleShader;
+    int m_PrefilterHalfPixel, m_PrefilterThreshold;
+    int m_DownsampleHalfPixel, m_UpsampleHalfPixel;
+    unsigned int m_VAO;
+
+    RenderTargetPool* m_Pool;
+    std::vector<RenderTarget*> m_Levels;  // Largest first
+    unsigned int m_Width, m_Height;
+    unsigned int m_Passes;
+    unsigned int m_Downsample;
+    float m_Threshold;
+};
+
+#endif // BLOOM_H
@@ -0,0 +1,17 @@
+#ifndef BLUENOISE_H
+#define BLUENOISE_H
+
+#include <cstdint>
+#include <vector>
+
+// Tileable blue-noise threshold map made with Ulichney's void-and-cluster
+// method. Neighbouring values differ as much as possible, so the noise has
+// no low-frequency clumps, and any threshold of it is an even dot pattern.
+class BlueNoise {
+public:
+    // size x size values in 0-255, row-major. Deterministic, so every
+    // launch gets the same texture.
+    static std::vector<uint8_t> Generate(unsigned int size);
+};
+
+#endif // BLUENOISE_H
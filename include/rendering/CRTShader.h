@@ -2,45 +2,236 @@
 #define CRTSHADER_H
 
 #include <glad/glad.h>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <random>
+#include <string>
+#include <vector>
+#include "rendering/ShaderProgram.h"
+#include "rendering/Bloom.h"
+#include "rendering/GPUTimer.h"
+#include "rendering/RenderTargetPool.h"
+
+// Effects of the post-process stack. Each enables one or more passes; an
+// effect whose parameter is zero is left out entirely.
+enum CRTEffect : uint32_t {
+    CRT_CURVATURE            = 1 << 0,
+    CRT_CHROMATIC_ABERRATION = 1 << 1,
+    CRT_SCANLINES            = 1 << 2,  // Includes the roll
+    CRT_VIGNETTE             = 1 << 3,
+    CRT_GLOW                 = 1 << 4,  // Bloom plus its composite
+    CRT_NOISE                = 1 << 5,  // Includes the flicker
+    CRT_PERSISTENCE          = 1 << 6,
+    // Not an effect: computes curvature and vignette per pixel instead of
+    // reading the warp LUT. Only used by Benchmark.
+    CRT_DIRECT_WARP          = 1 << 7
+};
 
 class CRTShader {
 public:
+    // Uniform buffer binding point of the CRTParameters block
+    static const unsigned int PARAMETERS_BINDING = 0;
+
+    // GLSL declaration of the CRTParameters block, for other post-process
+    // passes to paste into their shaders and bind to PARAMETERS_BINDING
+    static const char* GetParametersBlockSource();
+
     CRTShader();
     ~CRTShader();
 
     bool Initialize(unsigned int width, unsigned int height);
+    // Window size. With a virtual resolution set this only moves the final
+    // composite; the render targets keep their size. Otherwise the targets
+    // follow once the size has settled (see BeginRender).
     void Resize(unsigned int width, unsigned int height);
+
+    // Render the scene at a fixed width x height regardless of the window
+    // and scale it up, letterboxed, in the final composite. 0 x 0 follows
+    // the window again.
+    void SetVirtualResolution(unsigned int width, unsigned int height);
+    bool HasVirtualResolution() const { return m_VirtualWidth != 0; }
+    unsigned int GetVirtualWidth() const { return m_VirtualWidth; }
+    unsigned int GetVirtualHeight() const { return m_VirtualHeight; }
     
-    // Begin rendering to framebuffer
+    // Begin rendering to framebuffer. Size, scale and format changes since
+    // the last frame are applied here, all at once.
     void BeginRender();
     
     // End rendering and apply CRT effect
     void EndRender();
     
-    // Configuration
-    void SetScanlineIntensity(float intensity) { m_ScanlineIntensity = intensity; }
-    void SetCurvature(float amount) { m_Curvature = amount; }
-    void SetVignetteStrength(float strength) { m_VignetteStrength = strength; }
-    void SetChromaticAberration(float amount) { m_ChromaticAberration = amount; }
-    void SetGlowIntensity(float intensity) { m_GlowIntensity = intensity; }
-    void SetNoiseAmount(float amount) { m_NoiseAmount = amount; }
+    // Configuration. Setters only mark the parameter block dirty; it is
+    // uploaded by the next EndRender.
+    void SetScanlineIntensity(float intensity) { m_ScanlineIntensity = intensity; m_ParametersDirty = true; }
+    void SetCurvature(float amount) { m_Curvature = amount; m_ParametersDirty = true; }
+    void SetVignetteStrength(float strength) { m_VignetteStrength = strength; m_ParametersDirty = true; }
+    void SetChromaticAberration(float amount) { m_ChromaticAberration = amount; m_ParametersDirty = true; }
+    void SetGlowIntensity(float intensity) { m_GlowIntensity = intensity; m_ParametersDirty = true; }
+    void SetNoiseAmount(float amount) { m_NoiseAmount = amount; m_ParametersDirty = true; }
+    // With the effects off the scene is drawn straight to the window, unless
+    // a virtual resolution still needs it scaled and letterboxed
     void SetEnabled(bool enabled) { m_Enabled = enabled; }
+    // Phosphor persistence: share of a frame's brightness still lit 1/60 s
+    // later, 0 (off) to 0.95. The history target is only allocated once it
+    // is first used, and then kept until the render size changes.
+    void SetPersistence(float persistence);
+    float GetPersistence() const { return m_Persistence; }
+    // Glow blur: mip chain length and resolution divisor of its first level.
+    // False if its targets can't be allocated; the glow is off until a
+    // later change succeeds.
+    bool SetGlowPasses(unsigned int passes);
+    bool SetGlowDownsample(unsigned int divisor);
+    unsigned int GetGlowPasses() const { return m_Bloom.GetPasses(); }
+    unsigned int GetGlowDownsample() const { return m_Bloom.GetDownsample(); }
     
     bool IsEnabled() const { return m_Enabled; }
+    // Whether the next frame differs even if the scene doesn't: roll,
+    // grain, flicker or trails are on, or a window resize is still to be
+    // applied
+    bool IsAnimating() const;
+
+    // Color format of the scene and the intermediate targets: "rgba8",
+    // "rgb10a2" (finer gradients) or "srgb" (blends in linear light; needs
+    // an sRGB-capable window). False if unknown or unsupported.
+    bool SetColorFormat(const std::string& name);
+    const char* GetColorFormatName() const;
+    // Whether this frame's scene target is sRGB, so whatever draws into it
+    // has to hand over linear colors
+    bool IsSceneSRGB() const { return UsesScene() && m_Scene->format == GL_SRGB8_ALPHA8; }
+    // Viewport size between BeginRender and EndRender
+    unsigned int GetSceneWidth() const { return UsesScene() ? m_RenderWidth : m_Width; }
+    unsigned int GetSceneHeight() const { return UsesScene() ? m_RenderHeight : m_Height; }
+
+    // Quality: the scene and the CRT pass run at a fraction of the window
+    // (or virtual) resolution (MIN_RENDER_SCALE to 1 per axis) and are upscaled onto the
+    // window. In auto mode a governor picks the scale from measured GPU
+    // time; setting a scale switches to manual.
+    static constexpr float MIN_RENDER_SCALE = 0.5f;
+    void SetAutoQuality(bool enabled);
+    void SetRenderScale(float scale);
+    bool IsAutoQuality() const { return m_AutoQuality; }
+    float GetRenderScale() const { return m_RenderScale; }
+    // Smoothed GPU time of the scene plus post-process, 0 until measured
+    double GetGPUTime() const { return m_GPUTime; }
+
+    // GPU time per frame of the curvature + vignette pass at width x
+    // height, reading the warp LUT and computing it per pixel. Renders
+    // offscreen and waits for the GPU, so only for the bench command.
+    bool Benchmark(unsigned int width, unsigned int height, double& lutMilliseconds, double& directMilliseconds);
+
+    // Enabled CRTEffect bits, how many fused programs have been compiled,
+    // and how many fullscreen passes the last frame took
+    uint32_t GetEffectMask() const { return m_EffectMask; }
+    size_t GetVariantCount() const { return m_Variants.size(); }
+    unsigned int GetPassCount() const { return m_PassCount; }
+    // Names of the enabled passes, in stack order
+    std::string GetPassNames() const;
 
 private:
-    bool CreateFramebuffer();
+    // Where a pass of the stack may run. Consecutive coordinate, sample
+    // and color passes are fused into one program, in that order, so
+    // they cost a single fullscreen draw together.
+    enum class PassKind {
+        COORDINATE,  // Moves the position the frame is read at
+        SAMPLE,      // Reads the frame; at most one per fused program
+        COLOR,       // Changes its own pixel only
+        SIDE,        // Makes a texture for later passes from the frame as of
+                     // the last barrier; doesn't end the fused run
+        BARRIER      // Needs the finished frame; ends the fused run
+    };
+
+    struct Pass {
+        const char* name;
+        uint32_t effect;           // CRTEffect bit that enables it
+        PassKind kind;
+        const char* define;        // Fused passes: macro the whole program sees
+        const char* declarations;  // Fused passes: uniforms
+        const char* body;          // Fused passes: statements for main()
+        void (CRTShader::*run)(RenderTarget*& frame);  // Side and barrier passes
+    };
+
+    // The stack, in order
+    static const Pass PASSES[];
+    static bool IsFused(PassKind kind);
+
+    struct Variant {
+        std::unique_ptr<ShaderProgram> shader;  // Null if it failed to build
+        int timeLocation;
+        int noiseOffsetLocation;
+    };
+
+    bool AcquireTargets();
+    void ReleaseTargets();
+    void ApplyPendingChanges();
+    void UpdateRenderSize();
+    bool NeedsPostTarget() const;
+    // Whether the frame is drawn into m_Scene rather than the window
+    bool UsesScene() const { return m_Scene && (m_Enabled || m_VirtualWidth != 0); }
+    void BlitToWindow(RenderTarget* source);
+    void SetGlowAvailable(bool available);
+    void BakeWarpLUT(RenderTarget* target);
+    void UpdateQuality();
+
     bool CreateShader();
     void SetupQuad();
+    void UploadParameters();
+    uint32_t ComputeEffectMask() const;
+    // Compiles the fused program for a set of fused passes on first use;
+    // null if it doesn't build
+    Variant* GetVariant(uint32_t effectMask);
+    // Draw the fused passes in `effectMask` reading `source`. Falls back to
+    // a plain copy if that program doesn't build.
+    void DrawFused(uint32_t effectMask, RenderTarget* source, unsigned int framebuffer);
+    // Draw pending fused passes into a pool target, which becomes the frame
+    RenderTarget* Flush(uint32_t effectMask, RenderTarget* frame);
+    void RunPersistence(RenderTarget*& frame);
+    void RunBloom(RenderTarget*& frame);
     
-    unsigned int m_FBO;           // Framebuffer object
-    unsigned int m_TextureColorbuffer; // Texture attachment
-    unsigned int m_RBO;           // Renderbuffer object
+    RenderTargetPool m_Pool;
+    RenderTarget* m_Scene;        // The terminal draws here
+    RenderTarget* m_History;      // Last frame as persistence left it
+    RenderTarget* m_Post;         // Last pass output when scaled or virtual, upscaled onto the window
+    RenderTarget* m_Warp;         // Curvature displacement and vignette
+    std::vector<RenderTarget*> m_FrameTargets;  // Intermediates, released at the end of the frame
     unsigned int m_QuadVAO, m_QuadVBO;
-    unsigned int m_ShaderProgram;
+    // The warp LUT is baked at WARP_LUT_DOWNSAMPLE times less than the
+    // render size when curvature, vignette or the size change
+    ShaderProgram m_WarpShader;
+    float m_WarpCurvature, m_WarpVignette;  // Parameters the LUT was baked with
+    bool m_WarpDirty;
+    unsigned int m_NoiseTexture;      // Tiled blue noise for the grain
+    ShaderProgram m_PersistenceShader;
+    int m_PersistenceDecayLocation;
+    std::minstd_rand m_NoiseRandom;   // Per-frame noise offsets
+    Bloom m_Bloom;                    // Feeds the glow effect
+    bool m_GlowAvailable;             // m_Bloom has its targets
+    unsigned int m_BloomTexture;      // This frame's bloom, 0 if none
+    std::unordered_map<uint32_t, Variant> m_Variants;  // By fused CRTEffect mask
+    uint32_t m_EffectMask;
+    unsigned int m_PassCount;
+    unsigned int m_ParametersBuffer;  // Uniform buffer behind the CRTParameters block
+    bool m_ParametersDirty;
+    GLenum m_ColorFormat;             // Of the scene and intermediates
+    bool m_TargetsDirty;              // Render size or format changed
+    bool m_ResizePending;             // Window still being resized
+    double m_ResizeTime;              // Last window resize
     
     unsigned int m_Width, m_Height;
+    unsigned int m_VirtualWidth, m_VirtualHeight;  // 0 when following the window
+    unsigned int m_RenderWidth, m_RenderHeight;    // Internal resolution
     float m_Time;
+    double m_LastFrameTime;       // Unwrapped, for the persistence decay
+    float m_FrameSeconds;         // Since the previous frame
+    uint64_t m_FrameIndex;
+    uint64_t m_HistoryFrame;      // Frame m_History was made in
+    
+    // Quality governor
+    GPUTimer m_Timer;
+    float m_RenderScale;
+    bool m_AutoQuality;
+    double m_GPUTime;
+    unsigned int m_FramesSinceRescale;
     
     // Effect parameters
     float m_ScanlineIntensity;
@@ -49,6 +240,7 @@ private:
     float m_ChromaticAberration;
     float m_GlowIntensity;
     float m_NoiseAmount;
+    float m_Persistence;
     bool m_Enabled;
 };
 
@@ -0,0 +1,37 @@
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Binary files under cache/ that hold data derived from something else
+// (fonts, shader programs). Each starts with a magic number, a format
+// version and the key of the inputs it was made from, and is only trusted
+// when all three match. Files are read back with a single read and written
+// to a temporary file that is then moved into place, so a client starting
+// up meanwhile never sees half a cache.
+class CacheFile {
+public:
+    static constexpr uint64_t HASH_SEED = 0xCBF29CE484222325ull;
+
+    // 64-bit FNV-1a, chained from HASH_SEED
+    static uint64_t Hash(uint64_t hash, const void* data, size_t size);
+
+    // cache/<prefix>-<key in hex>.bin
+    static std::string GetPath(const char* prefix, uint64_t key);
+
+    // Fill `payload` with everything after the header. Returns false if the
+    // file is missing or unreadable, or was written for a different magic,
+    // version or key. `what` names the cache in messages.
+    static bool Read(const std::string& path, uint32_t magic, uint32_t version, uint64_t key,
+                     const char* what, std::vector<char>& payload);
+
+    // Write the header followed by `chunks` (pointer, byte count) in order
+    static bool WriteAtomically(const std::string& path, uint32_t magic, uint32_t version, uint64_t key,
+                                const char* what, const std::vector<std::pair<const void*, size_t>>& chunks);
+};
+
+#endif // CACHEFILE_H
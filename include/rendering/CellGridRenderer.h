@@ -0,0 +1,63 @@
+#ifndef CELLGRIDRENDERER_H
+#define CELLGRIDRENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "rendering/TextRenderer.h"
+#include "rendering/ShaderProgram.h"
+
+// Draws a monospace text grid in a single full-screen pass. The grid lives in
+// a small RGBA16UI texture (<glyph slot, foreground, background, attributes>
+// per cell) that the fragment shader resolves against the glyph atlas and
+// palette, so the cost of a frame does not depend on how much text is on
+// screen or how colorful it is.
+//
+// Rows are stored as a ring indexed by line sequence number: scrolling only
+// moves the ring start, and a changed line is one glTexSubImage2D row.
+class CellGridRenderer {
+public:
+    CellGridRenderer();
+    ~CellGridRenderer();
+
+    bool Initialize();
+
+    // Reallocate the cell texture for a grid of this size (no-op if unchanged)
+    void Resize(unsigned int columns, unsigned int rows);
+
+    // Store the UTF-8 text of line `seq`; uploads its row only if it changed
+    // or its glyphs were evicted from the atlas
+    void SetRow(uint64_t seq, const std::string& text, const std::vector<StyleRun>& styles,
+                TextRenderer* renderer);
+
+    // Draw `rowCount` rows starting at line `firstSeq`. `origin` is the left
+    // edge and top of the grid in framebuffer pixels.
+    void Draw(TextRenderer* renderer, glm::vec2 origin, float lineHeight,
+              uint64_t firstSeq, unsigned int rowCount);
+
+private:
+    struct RowState {
+        uint64_t seq;
+        std::string text;
+        std::vector<StyleRun> styles;
+        uint64_t glyphGeneration;  // Atlas generation the slots were resolved in
+        uint32_t glyphPages;       // Atlas pages the row's glyphs live in
+    };
+
+    bool CreateShader();
+    static bool SameStyles(const std::vector<StyleRun>& a, const std::vector<StyleRun>& b);
+
+    unsigned int m_CellTexture;
+    unsigned int m_VAO;
+    ShaderProgram m_Shader;
+    int m_OriginLocation, m_CellSizeLocation, m_GridSizeLocation;
+    int m_FirstRowLocation, m_RowCountLocation, m_SDFSpreadLocation;
+    int m_FragmentScaleLocation;
+    unsigned int m_Columns, m_Rows;
+    std::vector<RowState> m_RowStates;   // What each texture row holds
+    std::vector<uint16_t> m_RowScratch;  // Packing buffer for one row
+};
+
+#endif // CELLGRIDRENDERER_H
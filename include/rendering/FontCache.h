@@ -0,0 +1,41 @@
+#ifndef FONTCACHE_H
+#define FONTCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "rendering/GlyphAtlas.h"
+
+// Glyph bitmaps and metrics baked from a font, so later launches can fill
+// the atlas without starting FreeType at all. A cache file is keyed by the
+// font file's contents, the pixel size, the glyph set and the glyph format,
+// and is read back with a single read. SDF glyphs are the expensive ones to
+// generate, so they benefit most.
+class FontCache {
+public:
+    struct Glyph {
+        uint32_t codepoint;
+        Character character;   // Size, Bearing and Advance
+        size_t pixelOffset;    // Into the pixel blob, Size.y rows of Size.x bytes
+    };
+
+    // `sdfSpread` is 0 for coverage bitmaps
+    static uint64_t MakeKey(const std::vector<unsigned char>& fontData, unsigned int pixelSize,
+                            uint32_t firstCodepoint, uint32_t lastCodepoint, uint32_t sdfSpread);
+    static std::string GetPath(uint64_t key);
+
+    // Returns false on a missing, stale or corrupt file
+    bool Load(const std::string& path, uint64_t key);
+    bool Save(const std::string& path, uint64_t key) const;
+
+    void AddGlyph(uint32_t codepoint, const Character& character, const unsigned char* pixels, int pitch);
+
+    const std::vector<Glyph>& GetGlyphs() const { return m_Glyphs; }
+    const unsigned char* GetPixels(const Glyph& glyph) const { return m_Pixels.data() + glyph.pixelOffset; }
+
+private:
+    std::vector<Glyph> m_Glyphs;
+    std::vector<unsigned char> m_Pixels;
+};
+
+#endif // FONTCACHE_H
@@ -0,0 +1,65 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <glad/glad.h>
+#include <deque>
+#include <vector>
+
+// Swap interval, how many frames the CPU may run ahead of the GPU, and a
+// histogram of how long key presses take to reach a swap. Times are in
+// seconds on the glfwGetTime clock.
+class FramePacer {
+public:
+    static constexpr unsigned int MAX_FRAMES_IN_FLIGHT = 3;
+    static constexpr unsigned int BUCKET_COUNT = 8;
+
+    FramePacer();
+    ~FramePacer();
+
+    // 0 swaps immediately (may tear), 1 waits for the next vblank, 2 for
+    // every other one. Needs the window's context to be current.
+    void SetSwapInterval(int interval);
+    int GetSwapInterval() const { return m_SwapInterval; }
+
+    // Frames submitted but not finished on the GPU that the CPU may have
+    // before it starts another, 1 to MAX_FRAMES_IN_FLIGHT. 0 leaves it to
+    // the driver, which usually queues more and so adds latency.
+    void SetMaxFramesInFlight(unsigned int frames);
+    unsigned int GetMaxFramesInFlight() const { return m_MaxFramesInFlight; }
+
+    // Blocks until a frame may start. Read input after this, so it is as
+    // fresh as possible when the frame is drawn.
+    void WaitForFrameSlot();
+    // Right after the swap: fences the frame and records input latencies
+    void OnSwap(double now);
+    // A key press was handled at `time`; it is measured at the next swap
+    void OnInput(double time);
+
+    // Key-to-swap histogram. Bucket i counts latencies below
+    // GetBucketLimit(i) ms and at or above the previous limit; the last
+    // bucket has no upper limit.
+    static double GetBucketLimit(unsigned int bucket);
+    unsigned int GetBucketCount(unsigned int bucket) const { return m_Buckets[bucket]; }
+    unsigned int GetSampleCount() const { return m_SampleCount; }
+    double GetMeanLatency() const { return m_SampleCount ? m_LatencySum / m_SampleCount : 0.0; }
+    double GetMaxLatency() const { return m_MaxLatency; }
+    void ResetHistogram();
+
+    // Deletes the outstanding fences. Call while the context still exists;
+    // the destructor makes no GL calls.
+    void ReleaseFences();
+
+private:
+
+    int m_SwapInterval;
+    unsigned int m_MaxFramesInFlight;
+    std::deque<GLsync> m_Fences;       // Oldest first, one per unfinished frame
+    std::vector<double> m_PendingInput;  // Times of inputs not swapped yet
+
+    unsigned int m_Buckets[BUCKET_COUNT];
+    unsigned int m_SampleCount;
+    double m_LatencySum;   // Milliseconds
+    double m_MaxLatency;
+};
+
+#endif // FRAMEPACER_H
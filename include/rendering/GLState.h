@@ -0,0 +1,61 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL bindings the renderers use, so binding something
+// that is already bound never reaches the driver. Every program, vertex
+// array, texture and buffer bind has to go through here, otherwise the
+// shadow goes stale; objects are deleted through here for the same reason
+// (the GL unbinds a deleted object and may hand its name out again).
+//
+// Also counts the calls made each frame for the `stats` command.
+class GLState {
+public:
+    struct Counters {
+        unsigned int stateCalls;    // Binds that reached the driver
+        unsigned int skippedCalls;  // Binds dropped as redundant
+        unsigned int drawCalls;
+    };
+
+    static const unsigned int MAX_TEXTURE_UNITS = 8;
+
+    static void UseProgram(unsigned int program);
+    static void BindVertexArray(unsigned int vertexArray);
+    // Selects `unit` as the active texture unit if it isn't already
+    static void BindTexture(unsigned int unit, GLenum target, unsigned int texture);
+    static void BindBuffer(GLenum target, unsigned int buffer);
+    // Indexed binding (uniform blocks); also replaces the generic binding
+    static void BindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+
+    static void DrawArrays(GLenum mode, int first, int count);
+    static void DrawArraysInstanced(GLenum mode, int first, int count, int instanceCount);
+
+    static void DeleteProgram(unsigned int program);
+    static void DeleteVertexArray(unsigned int vertexArray);
+    static void DeleteTexture(unsigned int texture);
+    static void DeleteBuffer(unsigned int buffer);
+
+    // Frame boundary: the running counters become GetLastFrame()
+    static void BeginFrame();
+    static const Counters& GetLastFrame() { return s_LastFrame; }
+
+private:
+    // Texture and buffer targets that are shadowed; others always go through
+    static int TextureTargetIndex(GLenum target);
+    static int BufferTargetIndex(GLenum target);
+
+    static const int TEXTURE_TARGETS = 2;
+    static const int BUFFER_TARGETS = 3;
+
+    static unsigned int s_Program;
+    static unsigned int s_VertexArray;
+    static unsigned int s_ActiveUnit;
+    static unsigned int s_Textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    static unsigned int s_Buffers[BUFFER_TARGETS];
+
+    static Counters s_Frame;
+    static Counters s_LastFrame;
+};
+
+#endif // GLSTATE_H
@@ -0,0 +1,33 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+// GPU time of a span of commands, from GL_TIME_ELAPSED queries. Several
+// queries are kept in flight and read back frames later, so measuring
+// never waits on the GPU. Only one timer may be running at a time.
+class GPUTimer {
+public:
+    static const unsigned int QUERY_COUNT = 4;
+
+    GPUTimer();
+    ~GPUTimer();
+
+    bool Initialize();
+
+    // Spans are skipped while every query is still in flight
+    void Begin();
+    void End();
+
+    // Most recent finished span in milliseconds. Returns false if nothing
+    // finished since the last call.
+    bool Poll(double& milliseconds);
+
+private:
+    unsigned int m_Queries[QUERY_COUNT];
+    unsigned int m_Next;     // Query the next Begin uses
+    unsigned int m_Pending;  // Issued and not read back yet
+    bool m_Running;
+};
+
+#endif // GPUTIMER_H
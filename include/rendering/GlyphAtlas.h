@@ -0,0 +1,118 @@
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Character {
+    glm::vec2 UVMin;     // Top-left of the glyph inside the atlas
+    glm::vec2 UVMax;     // Bottom-right of the glyph inside the atlas
+    glm::ivec2 Size;
+    glm::ivec2 Bearing;
+    unsigned int Advance;
+    unsigned int Index;  // Slot in the GPU glyph table
+};
+
+// Glyph cache texture plus the GPU glyph table describing each slot.
+//
+// The atlas is split into horizontal pages. Glyphs are skyline-packed into
+// a page the first time they are needed; when nothing fits, the least
+// recently used page is emptied and its glyphs are forgotten. Pages used
+// during the current frame are never evicted, and every eviction bumps the
+// generation so cached layouts know their slots may have gone stale.
+//
+// Writes land in CPU copies of the texture and table and are uploaded by
+// Commit(), at most once per frame. Callers resolve every glyph a frame
+// needs before its first draw; glyphs that turn up after the commit wait
+// for the next frame.
+class GlyphAtlas {
+public:
+    static const unsigned int MAX_PAGES = 32;  // Page masks are 32 bits wide
+
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    bool Initialize(unsigned int width, unsigned int height, unsigned int pageCount, unsigned int maxGlyphs);
+
+    // Copy a glyph bitmap into the atlas and give it a table slot. Size and
+    // Bearing of `character` must be set; UVMin, UVMax and Index are filled
+    // in. Codepoints of glyphs evicted to make room are appended to
+    // `evicted`. Returns false if there is no room even after evicting.
+    bool AddGlyph(uint32_t codepoint, const unsigned char* pixels, int pitch,
+                  Character& character, std::vector<uint32_t>& evicted);
+
+    // Startup glyphs are never evicted
+    void PinAllocatedPages();
+
+    // Frame boundary for LRU tracking and the one-upload-per-frame rule
+    void BeginFrame() { ++m_Frame; }
+
+    // Keep the page holding `slot` resident this frame. Returns its bit.
+    uint32_t Touch(unsigned int slot) {
+        uint8_t page = m_SlotPages[slot];
+        if (page == NO_PAGE) {
+            return 0;
+        }
+        m_Pages[page].lastUsed = m_Frame;
+        return 1u << page;
+    }
+    void TouchPages(uint32_t pageMask);
+
+    // Upload pending pixels and table entries. Only the first call in a
+    // frame uploads; glyphs added after it wait for the next frame.
+    void Commit();
+    // Whether this frame's upload has happened, so new glyphs would not
+    // show until the next frame
+    bool IsCommitted() const { return m_CommittedFrame == m_Frame; }
+
+    // Make cached layouts resolve their glyphs again, e.g. ones that hold
+    // the fallback for a glyph that had to wait
+    void Invalidate() { ++m_Generation; }
+
+    uint64_t GetGeneration() const { return m_Generation; }
+    unsigned int GetTexture() const { return m_Texture; }
+    unsigned int GetTableTexture() const { return m_TableTexture; }
+
+private:
+    static constexpr uint8_t NO_PAGE = 0xFF;
+    // Units the textures are drawn from (ATLAS_UNIT, GLYPH_TABLE_UNIT), so
+    // binding them for an upload leaves them ready to draw with
+    static const unsigned int TEXTURE_UNIT = 0;
+    static const unsigned int TABLE_UNIT = 1;
+
+    struct Page {
+        std::vector<glm::ivec3> skyline;   // <x, y, width> segments, y from the page top
+        std::vector<unsigned int> slots;   // Glyphs packed into this page
+        std::vector<uint32_t> codepoints;
+        uint64_t lastUsed;
+        bool pinned;
+    };
+
+    bool Allocate(Page& page, int width, int height, glm::ivec2& position);
+    int FindSpace(int width, int height, glm::ivec2& position);
+    bool EvictLeastRecentlyUsed(std::vector<uint32_t>& evicted);
+    void MarkPixelsDirty(int x0, int y0, int x1, int y1);
+    void MarkSlotDirty(unsigned int slot);
+
+    unsigned int m_Texture;
+    unsigned int m_TableBuffer;    // Two RGBA32F texels per slot: uv rect, <size, bearing>
+    unsigned int m_TableTexture;   // Buffer texture view of m_TableBuffer
+    unsigned int m_Width, m_Height, m_PageHeight;
+
+    std::vector<unsigned char> m_Pixels;  // CPU copy of the texture
+    std::vector<glm::vec4> m_Table;       // CPU copy of the glyph table
+    std::vector<Page> m_Pages;
+    std::vector<uint8_t> m_SlotPages;     // Page of each slot, NO_PAGE if free
+    std::vector<unsigned int> m_FreeSlots;
+
+    glm::ivec2 m_DirtyMin, m_DirtyMax;    // Pending pixel rect, empty if min >= max
+    unsigned int m_DirtySlotMin, m_DirtySlotMax;
+
+    uint64_t m_Frame;
+    uint64_t m_CommittedFrame;
+    uint64_t m_Generation;
+};
+
+#endif // GLYPHATLAS_H
@@ -0,0 +1,30 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <cstdint>
+#include <string>
+
+// Linked program binaries kept on disk, so later launches skip compiling
+// and linking GLSL. A binary is only valid for the driver that produced it,
+// so the key covers the shader sources plus the GL vendor, renderer and
+// version strings; anything that doesn't match is simply compiled again.
+// Needs GL 4.1 program binaries and is a no-op without them.
+class ProgramCache {
+public:
+    static bool IsSupported();
+
+    static uint64_t MakeKey(const char* vertexSource, const char* fragmentSource);
+
+    // Fill `program` from the cached binary. Returns false, leaving the
+    // program unlinked, on a miss or if the driver rejects the binary.
+    static bool Load(uint64_t key, unsigned int program);
+
+    // The program must have been linked with
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    static bool Save(uint64_t key, unsigned int program);
+
+private:
+    static std::string GetPath(uint64_t key);
+};
+
+#endif // PROGRAMCACHE_H
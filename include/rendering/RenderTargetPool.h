@@ -0,0 +1,43 @@
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <glad/glad.h>
+#include <memory>
+#include <vector>
+
+// Offscreen color target: a texture attached to its own framebuffer. Only
+// 2D passes draw into these, so there is no depth or stencil buffer.
+struct RenderTarget {
+    unsigned int framebuffer;
+    unsigned int texture;
+    unsigned int width, height;
+    GLenum format;              // Sized internal format of the texture
+    bool inUse;
+};
+
+// Render targets handed out by size and format. Released targets stay
+// allocated and are handed out again to the next matching request, so
+// post-process passes can take intermediate targets every frame without
+// allocating anything.
+class RenderTargetPool {
+public:
+    RenderTargetPool();
+    ~RenderTargetPool();
+
+    // A free target matching the request, created if there is none.
+    // Null if the framebuffer can't be completed.
+    RenderTarget* Acquire(unsigned int width, unsigned int height, GLenum format);
+    void Release(RenderTarget* target);
+
+    // Delete every target not in use, e.g. after the sizes changed
+    void Trim();
+
+    size_t GetTargetCount() const { return m_Targets.size(); }
+
+private:
+    static void Destroy(RenderTarget& target);
+
+    std::vector<std::unique_ptr<RenderTarget>> m_Targets;
+};
+
+#endif // RENDERTARGETPOOL_H
@@ -0,0 +1,45 @@
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <glad/glad.h>
+#include <string>
+#include <unordered_map>
+
+// A linked vertex + fragment program. Every active uniform's location is
+// looked up once, right after linking; callers resolve the locations they
+// set per frame into plain ints at initialization, so drawing never asks
+// the driver for a location by name. Linked programs are kept in the
+// ProgramCache, so only the first launch pays for compiling.
+class ShaderProgram {
+public:
+    ShaderProgram();
+    ~ShaderProgram();
+
+    // `name` only labels error messages
+    bool Create(const std::string& name, const char* vertexSource, const char* fragmentSource);
+
+    // Goes through GLState, so using the current program is free
+    void Use() const;
+
+    // -1 for uniforms the program doesn't have (or the compiler dropped)
+    int GetUniformLocation(const std::string& uniform) const;
+
+    // Point a uniform block at a buffer binding point. Returns false if the
+    // program has no such block.
+    bool BindUniformBlock(const std::string& block, unsigned int binding);
+
+    unsigned int GetID() const { return m_Program; }
+
+private:
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    unsigned int Compile(GLenum type, const char* source);
+    void ResolveUniforms();
+
+    std::string m_Name;
+    unsigned int m_Program;
+    std::unordered_map<std::string, int> m_Uniforms;
+};
+
+#endif // SHADERPROGRAM_H
@@ -0,0 +1,58 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <vector>
+#include <cstddef>
+
+// Ring buffer for data that is rewritten every frame (glyph instances, etc).
+// The buffer is split into regions, one per frame in flight. Writes go
+// straight into mapped memory and each region is fenced once the GPU has
+// been handed its draws, so the CPU never overwrites data still in use and
+// the driver never has to stall on an implicit sync.
+//
+// Uses a persistently mapped buffer when glBufferStorage is available
+// (GL 4.4), otherwise maps each range with glMapBufferRange using the
+// unsynchronized + invalidate flags.
+class StreamBuffer {
+public:
+    StreamBuffer();
+    ~StreamBuffer();
+
+    bool Initialize(GLenum target, size_t regionSize, unsigned int regionCount = 3);
+
+    // Start a new frame: fences the current region and moves to the next one
+    void BeginFrame();
+
+    // Map at least minSize bytes. Returns the write pointer and the number of
+    // bytes available through it in outCapacity.
+    void* Map(size_t minSize, size_t& outCapacity);
+
+    // Commit the first `used` bytes of the last mapping. Returns their byte
+    // offset inside the buffer, for use as a vertex attribute offset.
+    size_t Unmap(size_t used);
+
+    unsigned int GetBuffer() const { return m_Buffer; }
+    bool IsPersistent() const { return m_Persistent; }
+    bool IsMapped() const { return m_Mapped != nullptr; }
+
+private:
+    bool CreateStorage(size_t regionSize);
+    void DestroyStorage();
+    void NextRegion();
+    void WaitForRegion(unsigned int region);
+
+    GLenum m_Target;
+    unsigned int m_Buffer;
+    size_t m_RegionSize;
+    unsigned int m_RegionCount;
+    unsigned int m_Region;        // Region currently being written
+    size_t m_Cursor;              // Write offset inside the current region
+    std::vector<GLsync> m_Fences; // One per region, null when not in flight
+
+    bool m_Persistent;
+    char* m_PersistentPtr;        // Base of the persistent mapping
+    void* m_Mapped;               // Active mapping, null when unmapped
+};
+
+#endif // STREAMBUFFER_H
@@ -0,0 +1,56 @@
+#ifndef TEXTMESH_H
+#define TEXTMESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <deque>
+#include <vector>
+#include "rendering/TextRenderer.h"
+
+// GPU-resident list of glyph instances for text that rarely changes.
+// Runs of instances are appended at the back and retired from the front
+// (like a scrolling terminal), and only the newly appended ones are uploaded.
+// Drawing it is a single instanced draw with a translation offset, so
+// steady-state frames do no per-glyph CPU work at all.
+class TextMesh {
+public:
+    TextMesh();
+    ~TextMesh();
+
+    // Append a run of pre-laid-out glyphs, translated by offset.
+    // `glyphPages` is the atlas page mask LayoutText returned for them.
+    void PushBack(const std::vector<GlyphInstance>& glyphs, glm::vec2 offset, uint32_t glyphPages);
+
+    // Retire the oldest run
+    void PopFront();
+
+    void Clear();
+
+    size_t GetInstanceCount() const { return m_Instances.size() - m_First; }
+
+    // Atlas pages the live runs reference, kept resident while drawn
+    uint32_t GetGlyphPages() const { return m_GlyphPages; }
+
+    // Upload pending changes. Returns the byte offset of the first live
+    // instance inside GetBuffer().
+    size_t Sync();
+    unsigned int GetBuffer() const { return m_Buffer; }
+
+private:
+    std::vector<GlyphInstance> m_Instances;  // CPU mirror of the buffer
+    size_t m_First;        // First live instance
+    size_t m_Uploaded;     // Instances [0, m_Uploaded) are on the GPU
+    uint32_t m_GlyphPages; // Union of the live runs' pages
+
+    struct Run {
+        size_t count;
+        uint32_t glyphPages;
+    };
+    std::deque<Run> m_Runs;  // Live runs, oldest first
+
+    unsigned int m_Buffer;
+    size_t m_Capacity;     // Size of m_Buffer in instances
+    bool m_Reupload;       // Buffer must be respecified from scratch
+};
+
+#endif // TEXTMESH_H
@@ -5,14 +5,87 @@
 #include <glm/glm.hpp>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <map>
+#include <array>
+#include <bitset>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include "rendering/StreamBuffer.h"
+#include "rendering/GlyphAtlas.h"
+#include "rendering/ShaderProgram.h"
 
-struct Character {
-    unsigned int TextureID;
-    glm::ivec2 Size;
-    glm::ivec2 Bearing;
-    unsigned int Advance;
+// Glyphs for 256 consecutive code points above the ASCII range
+struct GlyphPage {
+    std::array<Character, 256> glyphs;
+    std::bitset<256> loaded;
+};
+
+// Texture units the glyph resources live on, shared by every text pass.
+// Uploads bind to the same units, so drawing doesn't have to rebind.
+enum GlyphTextureUnit : unsigned int {
+    ATLAS_UNIT = 0,
+    GLYPH_TABLE_UNIT = 1,
+    PALETTE_UNIT = 3,
+    CELL_UNIT = 4            // Character cells of the grid pass
+};
+
+// Fixed slots of the palette texture. Colors passed to QueueText are
+// given slots from PALETTE_DYNAMIC up for the rest of the frame.
+enum PaletteSlot : uint8_t {
+    PALETTE_BACKGROUND = 0,  // Screen background, i.e. "no background"
+    PALETTE_FOREGROUND = 1,  // Default text color
+    PALETTE_ANSI = 2,        // The 16 ANSI colors, normal then bright
+    PALETTE_DYNAMIC = 18
+};
+
+// GlyphInstance::attr bits
+enum GlyphAttribute : uint8_t {
+    GLYPH_BOLD = 1 << 0,
+    GLYPH_DIM = 1 << 1,
+    GLYPH_INVERSE = 1 << 2,
+    GLYPH_CELL = 1 << 7      // Solid background cell instead of a glyph
+};
+
+// Colors (palette slots) and attributes of a span of text
+struct TextStyle {
+    uint8_t foreground = PALETTE_FOREGROUND;
+    uint8_t background = PALETTE_BACKGROUND;
+    uint8_t attributes = 0;
+
+    bool operator==(const TextStyle& other) const {
+        return foreground == other.foreground && background == other.background &&
+               attributes == other.attributes;
+    }
+    bool operator!=(const TextStyle& other) const { return !(*this == other); }
+};
+
+// Style from byte `start` of a string up to the next run. No runs at all
+// means the default style throughout.
+struct StyleRun {
+    size_t start;
+    TextStyle style;
+};
+
+// One glyph in the instance stream. The vertex shader expands it into a
+// quad using the glyph table, so the CPU uploads 16 bytes per character.
+struct GlyphInstance {
+    float x, y;          // Pen position on the baseline
+    uint16_t glyph;      // Slot in the GPU glyph table
+    uint16_t scale;      // 8.8 fixed point
+    uint8_t color;       // Foreground palette slot
+    uint8_t attr;        // GlyphAttribute bits
+    uint8_t background;  // Background palette slot
+    uint8_t width;       // Advance in pixels, for GLYPH_CELL instances
+};
+
+class TextMesh;
+
+// How glyphs are stored in the atlas
+enum class GlyphFormat {
+    BITMAP,  // Coverage, crisp at scale 1.0 only
+    SDF      // Signed distance fields, sharp at any scale
 };
 
 class TextRenderer {
@@ -20,22 +93,124 @@ public:
     TextRenderer(unsigned int width, unsigned int height);
     ~TextRenderer();
 
-    bool Initialize(const std::string& fontPath, unsigned int fontSize);
+    bool Initialize(const std::string& fontPath, unsigned int fontSize,
+                    GlyphFormat format = GlyphFormat::BITMAP);
+
+    // Batched rendering: queue any number of text runs, then draw them all
+    // with a single instanced draw call
+    void BeginBatch();
+    void QueueText(const std::string& text, float x, float y, float scale, glm::vec3 color);
+    void QueueText(const std::string& text, float x, float y, float scale, const std::vector<StyleRun>& styles);
+    void FlushBatch();
+
+    // Immediate rendering of a single run (queues it and flushes the batch)
     void RenderText(const std::string& text, float x, float y, float scale, glm::vec3 color);
+
+    // Lay out a run at the origin for caching in a TextMesh. Styles should
+    // only use fixed palette slots, since dynamic ones don't outlive the
+    // frame. Returns the mask of atlas pages the glyphs live in; the layout
+    // stays valid for as long as GetGlyphGeneration() doesn't change.
+    uint32_t LayoutText(const std::string& text, float scale, const std::vector<StyleRun>& styles,
+                        std::vector<GlyphInstance>& out);
+
+    // Palette texture shared by every draw
+    void SetPaletteColor(uint8_t slot, const glm::vec3& color);
+    unsigned int GetPaletteTexture() const { return m_PaletteTexture; }
+    // Store the palette as sRGB, so shaders read its colors as linear.
+    // Needed when drawing into sRGB targets, which encode on write.
+    void SetPaletteSRGB(bool srgb);
+
+    // Draw a cached mesh, translated by offset, on the next flush
+    void QueueMesh(TextMesh& mesh, glm::vec2 offset);
+
     void UpdateProjection(unsigned int width, unsigned int height);
+    glm::vec2 GetScreenSize() const { return m_ScreenSize; }
+    // Pixel size of the framebuffer text is drawn into this frame, which
+    // the CRT pass may shrink below the screen size
+    void SetViewportSize(unsigned int width, unsigned int height) { m_ViewportSize = glm::vec2(width, height); }
+    glm::vec2 GetViewportSize() const { return m_ViewportSize; }
 
     unsigned int GetFontHeight() const { return m_FontHeight; }
+    GlyphFormat GetGlyphFormat() const { return m_GlyphFormat; }
+    // Distance range of SDF glyphs in atlas pixels, 0 for bitmaps
+    float GetSDFSpread() const;
     unsigned int GetCharWidth(char c) const;
 
+    // Constant-time glyph lookup. Code points not rasterized yet, or that
+    // the font doesn't provide, resolve to the fallback glyph ('?').
+    const Character& GetCharacter(uint32_t codepoint) const;
+
+    // Like GetCharacter, but rasterizes the glyph into the atlas on first use
+    const Character& ResolveCharacter(uint32_t codepoint);
+
+    // Decode the UTF-8 sequence at text[index] and advance index past it.
+    // Malformed input decodes to U+FFFD one byte at a time.
+    static uint32_t NextCodepoint(const std::string& text, size_t& index);
+
+    // Glyph resources, for passes that resolve glyphs themselves. Such
+    // passes must touch the pages they use every frame, and resolve all of
+    // their glyphs before committing (atlas and palette) and drawing.
+    unsigned int GetGlyphIndex(uint32_t codepoint) { return ResolveCharacter(codepoint).Index; }
+    unsigned int GetAtlasTexture() const { return m_Atlas.GetTexture(); }
+    unsigned int GetGlyphTableTexture() const { return m_Atlas.GetTableTexture(); }
+    uint32_t TouchGlyph(unsigned int index) { return m_Atlas.Touch(index); }
+    void TouchGlyphPages(uint32_t pageMask) { m_Atlas.TouchPages(pageMask); }
+    void CommitGlyphs();
+    // Whether a glyph first needed after this frame's atlas upload was drawn
+    // as the fallback; another frame picks it up
+    bool HasDeferredGlyphs() const { return m_GlyphsDeferred; }
+
+    // Bumped whenever glyphs are evicted from the atlas, invalidating
+    // cached glyph slots
+    uint64_t GetGlyphGeneration() const { return m_Atlas.GetGeneration(); }
+
 private:
-    std::map<char, Character> m_Characters;
-    unsigned int m_VAO, m_VBO;
-    unsigned int m_ShaderProgram;
+    // Dense glyph table: a flat array for ASCII, then 256-entry pages for
+    // higher code points, allocated only when a glyph in them is loaded
+    std::array<Character, 128> m_AsciiGlyphs;
+    std::bitset<128> m_AsciiLoaded;
+    std::vector<std::unique_ptr<GlyphPage>> m_GlyphPages;  // Indexed by codepoint >> 8
+    Character m_FallbackGlyph;
+    GlyphFormat m_GlyphFormat;
+    GlyphAtlas m_Atlas;                // Texture and GPU table of every loaded glyph
+    std::vector<uint32_t> m_Evicted;   // Scratch list for AddGlyph
+    bool m_GlyphsDeferred;             // Set when the atlas had already been committed
+    std::vector<unsigned char> m_FontData;  // Font file, hashed for the cache and read by FreeType
+    FT_Library m_FreeType;             // Started on the first glyph the cache lacks
+    FT_Face m_Face;
+    unsigned int m_VAO;
+    StreamBuffer m_InstanceStream;     // Ring buffer the batch is written into
+    GlyphInstance* m_Batch;            // Mapped write pointer, null when unmapped
+    size_t m_BatchCount;               // Instances written through m_Batch
+    size_t m_BatchCapacity;            // Instances available through m_Batch
+    std::vector<glm::vec3> m_Palette;  // Dynamic colors, from slot PALETTE_DYNAMIC
+    std::vector<uint8_t> m_PaletteData;  // CPU copy of the palette texture, RGBA8
+    bool m_PaletteDirty;
+    bool m_PaletteSRGB;
+    unsigned int m_PaletteTexture;
+    float m_CellDescent;               // Background cells reach this far below the baseline
+    std::vector<std::pair<TextMesh*, glm::vec2>> m_QueuedMeshes;  // Drawn before the batch
+    ShaderProgram m_Shader;
+    int m_ProjectionLocation, m_OffsetLocation, m_CellMetricsLocation;
     glm::mat4 m_Projection;
+    glm::vec2 m_ScreenSize;            // Text coordinates span this, whatever the viewport
+    glm::vec2 m_ViewportSize;
     unsigned int m_FontHeight;
 
     bool LoadFont(const std::string& fontPath, unsigned int fontSize);
     bool CreateShaders();
+    bool OpenFace();
+    bool LoadGlyph(uint32_t codepoint, Character& character);
+    bool PlaceGlyph(uint32_t codepoint, const unsigned char* pixels, int pitch, Character& character);
+    void SetCharacter(uint32_t codepoint, const Character& character);
+    void ForgetCharacter(uint32_t codepoint);
+    void BeginDraw(glm::vec2 offset);
+    void BindInstanceAttributes(unsigned int buffer, size_t offset);
+    void DrawMesh(TextMesh& mesh, glm::vec2 offset);
+    size_t EmitGlyphs(const std::string& text, float x, float y, float scale,
+                      const StyleRun* styles, size_t styleCount, GlyphInstance* out, uint32_t& pageMask);
+    void ReserveBatch(size_t count);
+    uint8_t GetPaletteIndex(const glm::vec3& color);
 };
 
 #endif // TEXTRENDERER_H
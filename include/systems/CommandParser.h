@@ -52,7 +52,11 @@ private:
     void CmdLogout(const std::vector<std::string>& args);
     void CmdColor(const std::vector<std::string>& args);
     void CmdCRT(const std::vector<std::string>& args);
+    void CmdRender(const std::vector<std::string>& args);
+    void CmdStats(const std::vector<std::string>& args);
     void CmdSpeed(const std::vector<std::string>& args);
+    void CmdFps(const std::vector<std::string>& args);
+    void CmdPacing(const std::vector<std::string>& args);
     void CmdSave(const std::vector<std::string>& args);
     void CmdReset(const std::vector<std::string>& args);
 };
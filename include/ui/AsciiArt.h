@@ -26,7 +26,8 @@ public:
     void DisplayToTerminal(Terminal* terminal) const;
     void DisplayCachedToTerminal(const std::string& name, Terminal* terminal) const;
     
-    // Render ASCII art directly (without going through terminal)
+    // Render ASCII art directly (without going through terminal).
+    // Lines are queued into the renderer's batch and drawn on the next flush.
     void RenderDirect(TextRenderer* renderer, float x, float y, float scale) const;
     void RenderCachedDirect(const std::string& name, TextRenderer* renderer, float x, float y, float scale) const;
     
@@ -4,8 +4,17 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <memory>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include "rendering/TextRenderer.h"
+#include "rendering/TextMesh.h"
+#include "rendering/CellGridRenderer.h"
+
+enum class TerminalRenderMode {
+    BATCHED,     // Instanced glyph quads with cached per-line meshes
+    CELL_GRID    // One full-screen pass over a texture of character cells
+};
 
 class Terminal {
 public:
@@ -13,9 +22,15 @@ public:
     ~Terminal();
 
     void Initialize();
+    // Layout size in pixels: the window, or the virtual resolution
+    void Resize(unsigned int width, unsigned int height);
     void Update(float deltaTime);
+    // Queues every visible line into the renderer's batch; the caller
+    // flushes it once the rest of the frame's text is queued
     void Render(TextRenderer* renderer);
 
+    // ANSI SGR escapes (ESC[...m) in the line set its colors and attributes;
+    // every line starts out in the default style
     void AddLine(const std::string& line);
     void AddChar(char c);
     void DeleteChar();
@@ -25,6 +40,10 @@ public:
     void AddLineWithTypewriter(const std::string& line, float charsPerSecond = 50.0f);
     void SetTypewriterSpeed(float charsPerSecond) { m_TypewriterSpeed = charsPerSecond; }
     bool IsTyping() const { return m_IsTyping; }
+
+    // Seconds until Update next changes what is shown (cursor blink or
+    // typewriter), infinity if nothing is pending
+    float GetTimeUntilChange() const;
     
     std::string GetCurrentInput() const { return m_CurrentInput; }
     void SetPrompt(const std::string& prompt) { m_Prompt = prompt; }
@@ -33,28 +52,59 @@ public:
     // Color management
     void SetTextColor(float r, float g, float b);
     glm::vec3 GetTextColor() const { return m_TextColor; }
+    
+    // Render mode
+    void SetRenderMode(TerminalRenderMode mode) { m_RenderMode = mode; }
+    TerminalRenderMode GetRenderMode() const { return m_RenderMode; }
 
 private:
+    struct Line {
+        std::string text;                   // Without escape sequences
+        std::vector<StyleRun> styles;       // Parsed from the escapes
+        std::vector<GlyphInstance> glyphs;  // Cached layout of text
+        bool dirty;                         // glyphs need to be laid out again
+        uint32_t glyphPages;                // Atlas pages glyphs refers to
+        uint64_t glyphGeneration;           // Atlas generation glyphs was laid out in
+    };
+
     unsigned int m_Width;
     unsigned int m_Height;
     
-    std::deque<std::string> m_Lines;
+    std::deque<Line> m_Lines;
     std::string m_CurrentInput;
     std::string m_Prompt;
     glm::vec3 m_TextColor;  // RGB color
     
     // Typewriter effect state
     bool m_IsTyping;
-    std::string m_TypewriterBuffer;
+    std::string m_TypewriterBuffer;         // Escapes already parsed out
+    std::vector<StyleRun> m_TypewriterStyles;
     std::string m_CurrentTypingLine;
     float m_TypewriterTimer;
     float m_TypewriterSpeed;  // characters per second
     size_t m_TypewriterIndex;
     
+    uint64_t m_FirstLineSeq;  // Sequence number of m_Lines.front()
+
+    // Cached geometry of the visible, settled lines. Lines are placed at
+    // y = -(seq - m_MeshBaseSeq) * LINE_HEIGHT, so scrolling is a translation.
+    TextMesh m_Mesh;
+    uint64_t m_MeshBaseSeq;
+    uint64_t m_MeshStartSeq, m_MeshEndSeq; // Lines [start, end) are in m_Mesh
+    bool m_MeshDirty;                      // m_Mesh must be rebuilt
+    uint64_t m_MeshGlyphGeneration;        // Atlas generation m_Mesh is valid for
+
+    TerminalRenderMode m_RenderMode;
+    std::unique_ptr<CellGridRenderer> m_CellGrid;  // Created on first use
+
     unsigned int m_MaxVisibleLines;
     float m_CursorBlinkTimer;
     bool m_CursorVisible;
     
+    unsigned int VisibleLinesFor(unsigned int height) const;
+    void SyncMesh(TextRenderer* renderer, size_t startLine, size_t endLine);
+    void RenderCellGrid(TextRenderer* renderer, size_t startLine, const std::string& inputLine);
+    
     const float CURSOR_BLINK_RATE = 0.5f;
     const float LINE_HEIGHT = 20.0f;
     const float PADDING_LEFT = 10.0f;
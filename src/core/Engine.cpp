@@ -1,10 +1,11 @@
 #include <iostream>
 #include "core/Engine.h"
 #include "rendering/CRTShader.h"
+#include "rendering/GLState.h"
 #include <GLFW/glfw3.h>
 
 Engine::Engine(unsigned int width, unsigned int height)
-    : m_Width(width), m_Height(height), m_IsBooting(true), m_BootTimer(0.0f) {
+    : m_Width(width), m_Height(height), m_VirtualWidth(0), m_VirtualHeight(0), m_IsBooting(true), m_BootTimer(0.0f) {
 }
 
 Engine::~Engine() {
@@ -13,9 +14,21 @@ Engine::~Engine() {
 bool Engine::Initialize() {
     std::cout << "Initializing Engine..." << std::endl;
 
-    // Initialize text renderer
+    // Load settings first, since the font is loaded in the saved glyph
+    // format. Start from the defaults so keys missing from an older
+    // settings file keep sensible values.
+    m_Settings = Settings::GetDefaults();
+    if (Settings::SettingsExist("settings.json")) {
+        m_Settings.LoadFromFile("settings.json");
+    } else {
+        m_Settings.SaveToFile("settings.json");
+    }
+    
+    // Initialize text renderer. Bitmaps are crisp at scale 1.0; SDF glyphs
+    // are opt-in for setups that scale text.
     m_TextRenderer = std::make_unique<TextRenderer>(m_Width, m_Height);
-    if (!m_TextRenderer->Initialize("assets/fonts/monospace.ttf", 20)) {  // Changed from 16 to 20
+    GlyphFormat glyphFormat = m_Settings.glyphFormat == "sdf" ? GlyphFormat::SDF : GlyphFormat::BITMAP;
+    if (!m_TextRenderer->Initialize("assets/fonts/monospace.ttf", 20, glyphFormat)) {
         std::cerr << "Failed to initialize text renderer" << std::endl;
         return false;
     }
@@ -47,14 +60,6 @@ bool Engine::Initialize() {
     // Initialize save manager
     m_SaveManager = std::make_unique<SaveManager>();
     
-    // Load settings first
-    if (Settings::SettingsExist("settings.json")) {
-        m_Settings.LoadFromFile("settings.json");
-    } else {
-        m_Settings = Settings::GetDefaults();
-        m_Settings.SaveToFile("settings.json");
-    }
-    
     // Apply loaded settings
     ApplySettings();
     
@@ -98,14 +103,36 @@ void Engine::Update(float deltaTime) {
 }
 
 void Engine::Render() {
+    double frameStart = glfwGetTime();
+    GLState::BeginFrame();
+
     // Begin rendering to CRT framebuffer
     m_CRTShader->BeginRender();
+    m_TextRenderer->SetPaletteSRGB(m_CRTShader->IsSceneSRGB());
+    m_TextRenderer->SetViewportSize(m_CRTShader->GetSceneWidth(), m_CRTShader->GetSceneHeight());
     
-    // Render terminal
+    // Render terminal - all visible text goes out in one batched draw
+    m_TextRenderer->BeginBatch();
     m_Terminal->Render(m_TextRenderer.get());
+    m_TextRenderer->FlushBatch();
     
     // Apply CRT effect
     m_CRTShader->EndRender();
+
+    // Until input arrives, the next frame is only needed when the boot
+    // sequence, the CRT animation or a terminal timer changes the picture,
+    // or when glyphs missed this frame's atlas upload. Text changes draw at
+    // the full rate; animation alone slows down idle
+    m_FrameScheduler.OnFrame(frameStart);
+    double now = glfwGetTime();
+    if (m_IsBooting || m_TextRenderer->HasDeferredGlyphs()) {
+        m_FrameScheduler.RequestFrame();
+    } else {
+        m_FrameScheduler.RequestFrameAt(now + m_Terminal->GetTimeUntilChange());
+        if (m_CRTShader->IsAnimating()) {
+            m_FrameScheduler.RequestAnimationFrame(now);
+        }
+    }
 }
 
 void Engine::Shutdown() {
@@ -114,6 +141,9 @@ void Engine::Shutdown() {
     // Save settings and game data before shutdown
     SaveSettings();
     SaveGameData();
+    
+    // The GL context is destroyed right after this
+    m_FramePacer.ReleaseFences();
 }
 
 void Engine::GenerateNewGameData() {
@@ -140,9 +170,22 @@ void Engine::SaveSettings() {
     // Collect current settings from components
     m_Settings.textColor = m_Terminal->GetTextColor();
     m_Settings.typewriterSpeed = 50.0f; // Terminal doesn't expose this currently
+    m_Settings.targetFPS = m_FrameScheduler.GetTargetFPS();
+    m_Settings.swapInterval = m_FramePacer.GetSwapInterval();
+    m_Settings.framesInFlight = m_FramePacer.GetMaxFramesInFlight();
     
     if (m_CRTShader) {
         m_Settings.crtEnabled = m_CRTShader->IsEnabled();
+        m_Settings.glowPasses = m_CRTShader->GetGlowPasses();
+        m_Settings.glowDownsample = m_CRTShader->GetGlowDownsample();
+        m_Settings.persistence = m_CRTShader->GetPersistence();
+        m_Settings.colorFormat = m_CRTShader->GetColorFormatName();
+        m_Settings.virtualWidth = m_VirtualWidth;
+        m_Settings.virtualHeight = m_VirtualHeight;
+        m_Settings.autoQuality = m_CRTShader->IsAutoQuality();
+        if (!m_Settings.autoQuality) {
+            m_Settings.renderScale = m_CRTShader->GetRenderScale();
+        }
         // CRT shader doesn't expose getters, so settings are already stored in m_Settings
     }
     
@@ -160,6 +203,11 @@ void Engine::ApplySettings() {
         m_Terminal->SetTypewriterSpeed(m_Settings.typewriterSpeed);
     }
     
+    // Apply frame rate cap and pacing
+    m_FrameScheduler.SetTargetFPS(m_Settings.targetFPS);
+    m_FramePacer.SetSwapInterval(m_Settings.swapInterval);
+    m_FramePacer.SetMaxFramesInFlight(m_Settings.framesInFlight);
+    
     // Apply CRT settings
     if (m_CRTShader) {
         m_CRTShader->SetEnabled(m_Settings.crtEnabled);
@@ -168,15 +216,64 @@ void Engine::ApplySettings() {
         m_CRTShader->SetVignetteStrength(m_Settings.vignetteStrength);
         m_CRTShader->SetChromaticAberration(m_Settings.chromaticAberration);
         m_CRTShader->SetGlowIntensity(m_Settings.glowIntensity);
+        m_CRTShader->SetGlowPasses(m_Settings.glowPasses);
+        m_CRTShader->SetGlowDownsample(m_Settings.glowDownsample);
         m_CRTShader->SetNoiseAmount(m_Settings.noiseAmount);
+        m_CRTShader->SetPersistence(m_Settings.persistence);
+        m_CRTShader->SetColorFormat(m_Settings.colorFormat);
+        if (m_Settings.autoQuality) {
+            m_CRTShader->SetAutoQuality(true);
+        } else {
+            m_CRTShader->SetRenderScale(m_Settings.renderScale);
+        }
+    }
+    
+    SetVirtualResolution(m_Settings.virtualWidth, m_Settings.virtualHeight);
+}
+
+void Engine::SetGlyphFormat(GlyphFormat format) {
+    m_Settings.glyphFormat = format == GlyphFormat::SDF ? "sdf" : "bitmap";
+}
+
+void Engine::SetVirtualResolution(unsigned int width, unsigned int height) {
+    if (width == 0 || height == 0) {
+        width = height = 0;
+    }
+    m_VirtualWidth = width;
+    m_VirtualHeight = height;
+    
+    // Everything but the final composite sees the layout size
+    unsigned int layoutWidth = width ? width : m_Width;
+    unsigned int layoutHeight = height ? height : m_Height;
+    if (m_TextRenderer) {
+        m_TextRenderer->UpdateProjection(layoutWidth, layoutHeight);
+    }
+    if (m_Terminal) {
+        m_Terminal->Resize(layoutWidth, layoutHeight);
+    }
+    if (m_CRTShader) {
+        m_CRTShader->SetVirtualResolution(width, height);
     }
 }
 
 void Engine::OnResize(int width, int height) {
+    // Minimizing reports 0 x 0; keep the layout for when the window returns
+    if (width <= 0 || height <= 0) {
+        return;
+    }
     m_Width = width;
     m_Height = height;
-    if (m_TextRenderer) {
-        m_TextRenderer->UpdateProjection(width, height);
+    m_FrameScheduler.RequestFrame();
+    m_FrameScheduler.OnInput(glfwGetTime());
+    
+    // At a virtual resolution only the final composite follows the window
+    if (m_VirtualWidth == 0) {
+        if (m_TextRenderer) {
+            m_TextRenderer->UpdateProjection(width, height);
+        }
+        if (m_Terminal) {
+            m_Terminal->Resize(width, height);
+        }
     }
     if (m_CRTShader) {
         m_CRTShader->Resize(width, height);
@@ -187,6 +284,10 @@ void Engine::OnKeyPress(int key, int scancode, int action, int mods) {
     if (action != GLFW_PRESS && action != GLFW_REPEAT) {
         return;
     }
+    double now = glfwGetTime();
+    m_FrameScheduler.RequestFrame();
+    m_FrameScheduler.OnInput(now);
+    m_FramePacer.OnInput(now);
 
     // Skip input during boot
     if (m_IsBooting) {
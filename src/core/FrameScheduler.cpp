@@ -0,0 +1,41 @@
+#include "core/FrameScheduler.h"
+#include <algorithm>
+#include <limits>
+
+// Longer gaps are idle time; capped so one doesn't linger in the average
+static const double MAX_MEASURED_INTERVAL = 1.0;
+
+FrameScheduler::FrameScheduler()
+    : m_TargetFPS(60), m_Deadline(0.0), m_LastFrame(0.0), m_LastInput(0.0), m_FrameInterval(0.0) {
+}
+
+void FrameScheduler::SetTargetFPS(unsigned int fps) {
+    m_TargetFPS = std::max(MIN_FPS, std::min(fps, MAX_FPS));
+}
+
+void FrameScheduler::RequestFrameAt(double time) {
+    m_Deadline = std::min(m_Deadline, time);
+}
+
+void FrameScheduler::RequestAnimationFrame(double now) {
+    if (IsIdle(now)) {
+        RequestFrameAt(m_LastFrame + 1.0 / IDLE_FPS);
+    } else {
+        RequestFrame();
+    }
+}
+
+double FrameScheduler::GetWaitTime(double now) const {
+    if (m_Deadline == std::numeric_limits<double>::infinity()) {
+        return m_Deadline;
+    }
+    double earliest = m_LastFrame + 1.0 / m_TargetFPS;
+    return std::max(m_Deadline, earliest) - now;
+}
+
+void FrameScheduler::OnFrame(double now) {
+    double interval = std::min(now - m_LastFrame, MAX_MEASURED_INTERVAL);
+    m_FrameInterval = m_FrameInterval > 0.0 ? m_FrameInterval * 0.9 + interval * 0.1 : interval;
+    m_LastFrame = now;
+    m_Deadline = std::numeric_limits<double>::infinity();
+}
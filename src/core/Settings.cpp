@@ -11,6 +11,10 @@ Settings Settings::GetDefaults() {
     // Display defaults
     defaults.textColor = glm::vec3(0.0f, 1.0f, 0.0f);  // Green
     defaults.typewriterSpeed = 50.0f;
+    defaults.targetFPS = 60;
+    defaults.swapInterval = 1;
+    defaults.framesInFlight = 0;
+    defaults.glyphFormat = "bitmap";
     
     // CRT defaults (subtle settings)
     defaults.crtEnabled = true;
@@ -19,7 +23,15 @@ Settings Settings::GetDefaults() {
     defaults.vignetteStrength = 0.15f;
     defaults.chromaticAberration = 0.3f;
     defaults.glowIntensity = 0.1f;
+    defaults.glowPasses = 4;
+    defaults.glowDownsample = 2;
     defaults.noiseAmount = 0.02f;
+    defaults.persistence = 0.0f;
+    defaults.colorFormat = "rgba8";
+    defaults.virtualWidth = 0;
+    defaults.virtualHeight = 0;
+    defaults.autoQuality = true;
+    defaults.renderScale = 1.0f;
     
     return defaults;
 }
@@ -31,6 +43,10 @@ bool Settings::SaveToFile(const std::string& filename) {
         // Save display settings
         settingsJson["textColor"] = {textColor.r, textColor.g, textColor.b};
         settingsJson["typewriterSpeed"] = typewriterSpeed;
+        settingsJson["targetFPS"] = targetFPS;
+        settingsJson["swapInterval"] = swapInterval;
+        settingsJson["framesInFlight"] = framesInFlight;
+        settingsJson["glyphFormat"] = glyphFormat;
         
         // Save CRT settings
         settingsJson["crtEnabled"] = crtEnabled;
@@ -39,7 +55,15 @@ bool Settings::SaveToFile(const std::string& filename) {
         settingsJson["vignetteStrength"] = vignetteStrength;
         settingsJson["chromaticAberration"] = chromaticAberration;
         settingsJson["glowIntensity"] = glowIntensity;
+        settingsJson["glowPasses"] = glowPasses;
+        settingsJson["glowDownsample"] = glowDownsample;
         settingsJson["noiseAmount"] = noiseAmount;
+        settingsJson["persistence"] = persistence;
+        settingsJson["colorFormat"] = colorFormat;
+        settingsJson["virtualWidth"] = virtualWidth;
+        settingsJson["virtualHeight"] = virtualHeight;
+        settingsJson["autoQuality"] = autoQuality;
+        settingsJson["renderScale"] = renderScale;
         
         // Create saves directory if needed
         std::system("mkdir -p saves");
@@ -83,6 +107,18 @@ bool Settings::LoadFromFile(const std::string& filename) {
         if (settingsJson.contains("typewriterSpeed")) {
             typewriterSpeed = settingsJson["typewriterSpeed"];
         }
+        if (settingsJson.contains("targetFPS")) {
+            targetFPS = settingsJson["targetFPS"];
+        }
+        if (settingsJson.contains("swapInterval")) {
+            swapInterval = settingsJson["swapInterval"];
+        }
+        if (settingsJson.contains("framesInFlight")) {
+            framesInFlight = settingsJson["framesInFlight"];
+        }
+        if (settingsJson.contains("glyphFormat")) {
+            glyphFormat = settingsJson["glyphFormat"];
+        }
         
         // Load CRT settings
         if (settingsJson.contains("crtEnabled")) {
@@ -103,9 +139,33 @@ bool Settings::LoadFromFile(const std::string& filename) {
         if (settingsJson.contains("glowIntensity")) {
             glowIntensity = settingsJson["glowIntensity"];
         }
+        if (settingsJson.contains("glowPasses")) {
+            glowPasses = settingsJson["glowPasses"];
+        }
+        if (settingsJson.contains("glowDownsample")) {
+            glowDownsample = settingsJson["glowDownsample"];
+        }
         if (settingsJson.contains("noiseAmount")) {
             noiseAmount = settingsJson["noiseAmount"];
         }
+        if (settingsJson.contains("persistence")) {
+            persistence = settingsJson["persistence"];
+        }
+        if (settingsJson.contains("colorFormat")) {
+            colorFormat = settingsJson["colorFormat"];
+        }
+        if (settingsJson.contains("virtualWidth")) {
+            virtualWidth = settingsJson["virtualWidth"];
+        }
+        if (settingsJson.contains("virtualHeight")) {
+            virtualHeight = settingsJson["virtualHeight"];
+        }
+        if (settingsJson.contains("autoQuality")) {
+            autoQuality = settingsJson["autoQuality"];
+        }
+        if (settingsJson.contains("renderScale")) {
+            renderScale = settingsJson["renderScale"];
+        }
         
         std::cout << "Settings loaded from saves/" << filename << std::endl;
         return true;
@@ -1,10 +1,12 @@
 #include <iostream>
+#include <cmath>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "core/Engine.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void window_refresh_callback(GLFWwindow* window);
 
 
 int main() {
@@ -18,6 +20,8 @@ int main() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Lets the CRT pass use sRGB targets (crt format srgb)
+    glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
     
     #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -39,6 +43,7 @@ int main() {
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
     // Load OpenGL function pointers
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -60,11 +65,36 @@ int main() {
     // Set window user pointer for callbacks
     glfwSetWindowUserPointer(window, &engine);
 
-    // Main loop
-    float lastFrame = 0.0f;
+    // Main loop: sleeps until the scheduler wants a frame or an event
+    // arrives, instead of drawing as fast as possible
+    FrameScheduler& scheduler = engine.GetFrameScheduler();
+    FramePacer& pacer = engine.GetFramePacer();
+    double lastFrame = glfwGetTime();
     while (!glfwWindowShouldClose(window)) {
-        float currentFrame = static_cast<float>(glfwGetTime());
-        float deltaTime = currentFrame - lastFrame;
+        // Nothing is drawn while minimized or hidden; only an event can
+        // change that
+        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) || !glfwGetWindowAttrib(window, GLFW_VISIBLE)) {
+            glfwWaitEvents();
+            continue;
+        }
+
+        double wait = scheduler.GetWaitTime(glfwGetTime());
+        if (wait > 0.0) {
+            if (std::isinf(wait)) {
+                glfwWaitEvents();
+            } else {
+                glfwWaitEventsTimeout(wait);
+            }
+            continue;  // Events may have asked for an earlier frame
+        }
+
+        // Input is read as late as possible: after waiting for the GPU to
+        // catch up, right before the frame that shows it
+        pacer.WaitForFrameSlot();
+        glfwPollEvents();
+
+        double currentFrame = glfwGetTime();
+        float deltaTime = static_cast<float>(currentFrame - lastFrame);
         lastFrame = currentFrame;
 
         // Update
@@ -77,7 +107,7 @@ int main() {
         engine.Render();
 
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        pacer.OnSwap(glfwGetTime());
     }
 
     // Cleanup
@@ -94,6 +124,14 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     }
 }
 
+void window_refresh_callback(GLFWwindow* window) {
+    // Part of the window was exposed and has to be drawn again
+    Engine* engine = static_cast<Engine*>(glfwGetWindowUserPointer(window));
+    if (engine) {
+        engine->GetFrameScheduler().RequestFrame();
+    }
+}
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if(key == GLFW_KEY_F11 && action == GLFW_PRESS){
         static bool isFullscreen = true;
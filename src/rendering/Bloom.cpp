@@ -0,0 +1,215 @@
+#include "rendering/Bloom.h"
+#include "rendering/GLState.h"
+#include <iostream>
+#include <algorithm>
+#include <string>
+
+// Full-screen triangle, no vertex buffer needed
+const char* bloomVertexShader = R"(
+#version 330 core
+out vec2 TexCoords;
+
+void main()
+{
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = pos;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Dual-Kawase downsample: centre plus four diagonal taps half a target
+// pixel away, each bilinear tap averaging four source texels. The
+// prefilter variant also applies the bright-pass.
+const char* bloomDownsampleShader = R"(
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 halfPixel;
+#ifdef PREFILTER
+uniform float threshold;
+#endif
+
+void main()
+{
+    vec3 sum = texture(source, TexCoords).rgb * 4.0;
+    sum += texture(source, TexCoords - halfPixel).rgb;
+    sum += texture(source, TexCoords + halfPixel).rgb;
+    sum += texture(source, TexCoords + vec2(halfPixel.x, -halfPixel.y)).rgb;
+    sum += texture(source, TexCoords - vec2(halfPixel.x, -halfPixel.y)).rgb;
+    vec3 color = sum / 8.0;
+
+#ifdef PREFILTER
+    // Keep only what is brighter than the threshold, without a hard edge
+    float brightness = max(color.r, max(color.g, color.b));
+    color *= max(brightness - threshold, 0.0) / max(brightness, 0.0001);
+#endif
+
+    FragColor = vec4(color, 1.0);
+}
+)";
+
+// Dual-Kawase upsample: an 8-tap tent around the target pixel. Blended
+// additively onto the level above.
+const char* bloomUpsampleShader = R"(
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 halfPixel;
+
+void main()
+{
+    vec3 sum = texture(source, TexCoords + vec2(-halfPixel.x * 2.0, 0.0)).rgb;
+    sum += texture(source, TexCoords + vec2(-halfPixel.x, halfPixel.y)).rgb * 2.0;
+    sum += texture(source, TexCoords + vec2(0.0, halfPixel.y * 2.0)).rgb;
+    sum += texture(source, TexCoords + vec2(halfPixel.x, halfPixel.y)).rgb * 2.0;
+    sum += texture(source, TexCoords + vec2(halfPixel.x * 2.0, 0.0)).rgb;
+    sum += texture(source, TexCoords + vec2(halfPixel.x, -halfPixel.y)).rgb * 2.0;
+    sum += texture(source, TexCoords + vec2(0.0, -halfPixel.y * 2.0)).rgb;
+    sum += texture(source, TexCoords + vec2(-halfPixel.x, -halfPixel.y)).rgb * 2.0;
+    FragColor = vec4(sum / 12.0, 1.0);
+}
+)";
+
+// Every pass samples its source on unit 0
+static const unsigned int SOURCE_UNIT = 0;
+
+// Packed float keeps the added-up levels from clipping at 1.0
+static const GLenum LEVEL_FORMAT = GL_R11F_G11F_B10F;
+
+Bloom::Bloom()
+    : m_PrefilterHalfPixel(-1), m_PrefilterThreshold(-1),
+      m_DownsampleHalfPixel(-1), m_UpsampleHalfPixel(-1), m_VAO(0), m_Pool(nullptr),
+      m_Width(0), m_Height(0), m_Passes(MAX_PASSES), m_Downsample(2), m_Threshold(0.2f) {
+}
+
+Bloom::~Bloom() {
+    ReleaseLevels();
+    if (m_VAO) GLState::DeleteVertexArray(m_VAO);
+}
+
+bool Bloom::Initialize(unsigned int width, unsigned int height, RenderTargetPool* pool) {
+    m_Width = width;
+    m_Height = height;
+    m_Pool = pool;
+
+    std::string downsample = std::string("#version 330 core\n") + bloomDownsampleShader;
+    std::string prefilter = std::string("#version 330 core\n#define PREFILTER\n") + bloomDownsampleShader;
+    if (!m_PrefilterShader.Create("Bloom prefilter", bloomVertexShader, prefilter.c_str()) ||
+        !m_DownsampleShader.Create("Bloom downsample", bloomVertexShader, downsample.c_str()) ||
+        !m_UpsampleShader.Create("Bloom upsample", bloomVertexShader, bloomUpsampleShader)) {
+        return false;
+    }
+
+    m_PrefilterHalfPixel = m_PrefilterShader.GetUniformLocation("halfPixel");
+    m_PrefilterThreshold = m_PrefilterShader.GetUniformLocation("threshold");
+    m_DownsampleHalfPixel = m_DownsampleShader.GetUniformLocation("halfPixel");
+    m_UpsampleHalfPixel = m_UpsampleShader.GetUniformLocation("halfPixel");
+    for (ShaderProgram* shader : {&m_PrefilterShader, &m_DownsampleShader, &m_UpsampleShader}) {
+        shader->Use();
+        glUniform1i(shader->GetUniformLocation("source"), SOURCE_UNIT);
+    }
+
+    // Core profile needs a VAO bound even though there are no attributes
+    glGenVertexArrays(1, &m_VAO);
+
+    CreateLevels();
+    return true;
+}
+
+bool Bloom::Resize(unsigned int width, unsigned int height) {
+    if (width == m_Width && height == m_Height && HasLevels()) {
+        return true;
+    }
+    m_Width = width;
+    m_Height = height;
+    return CreateLevels();
+}
+
+bool Bloom::SetPasses(unsigned int passes) {
+    passes = std::max(1u, std::min(passes, MAX_PASSES));
+    if (passes == m_Passes && HasLevels()) {
+        return true;
+    }
+    m_Passes = passes;
+    return CreateLevels();
+}
+
+bool Bloom::SetDownsample(unsigned int divisor) {
+    // Round down to a power of two in [2, MAX_DOWNSAMPLE]
+    unsigned int power = 2;
+    while (power * 2 <= divisor && power * 2 <= MAX_DOWNSAMPLE) {
+        power *= 2;
+    }
+    if (power == m_Downsample && HasLevels()) {
+        return true;
+    }
+    m_Downsample = power;
+    return CreateLevels();
+}
+
+bool Bloom::CreateLevels() {
+    // Released first, so levels that keep their size get the same targets
+    ReleaseLevels();
+    if (m_Width == 0 || m_Height == 0 || !m_Pool) {
+        return true;
+    }
+
+    for (unsigned int i = 0, divisor = m_Downsample; i < m_Passes && divisor <= MAX_DOWNSAMPLE; ++i, divisor *= 2) {
+        RenderTarget* level = m_Pool->Acquire(std::max(1u, m_Width / divisor),
+                                              std::max(1u, m_Height / divisor), LEVEL_FORMAT);
+        if (!level) {
+            std::cerr << "ERROR: Failed to create bloom level " << i << std::endl;
+            ReleaseLevels();
+            return false;
+        }
+        m_Levels.push_back(level);
+    }
+    return true;
+}
+
+void Bloom::ReleaseLevels() {
+    for (RenderTarget* level : m_Levels) {
+        m_Pool->Release(level);
+    }
+    m_Levels.clear();
+}
+
+void Bloom::DrawLevel(const RenderTarget& target, ShaderProgram& shader, int halfPixelLocation) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glViewport(0, 0, target.width, target.height);
+    shader.Use();
+    glUniform2f(halfPixelLocation, 0.5f / target.width, 0.5f / target.height);
+    GLState::DrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+unsigned int Bloom::Render(unsigned int sourceTexture) {
+    if (m_Levels.empty()) {
+        return 0;
+    }
+
+    GLState::BindVertexArray(m_VAO);
+
+    // Down the chain: each level overwrites its target completely
+    glDisable(GL_BLEND);
+    m_PrefilterShader.Use();
+    glUniform1f(m_PrefilterThreshold, m_Threshold);
+    GLState::BindTexture(SOURCE_UNIT, GL_TEXTURE_2D, sourceTexture);
+    DrawLevel(*m_Levels[0], m_PrefilterShader, m_PrefilterHalfPixel);
+    for (size_t i = 1; i < m_Levels.size(); ++i) {
+        GLState::BindTexture(SOURCE_UNIT, GL_TEXTURE_2D, m_Levels[i - 1]->texture);
+        DrawLevel(*m_Levels[i], m_DownsampleShader, m_DownsampleHalfPixel);
+    }
+
+    // Back up: each blurrier level is added onto the one above it
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    for (size_t i = m_Levels.size() - 1; i > 0; --i) {
+        GLState::BindTexture(SOURCE_UNIT, GL_TEXTURE_2D, m_Levels[i]->texture);
+        DrawLevel(*m_Levels[i - 1], m_UpsampleShader, m_UpsampleHalfPixel);
+    }
+
+    return m_Levels[0]->texture;
+}
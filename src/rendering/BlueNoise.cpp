@@ -0,0 +1,121 @@
+#include "rendering/BlueNoise.h"
+#include <cmath>
+#include <algorithm>
+#include <random>
+
+// Width of the Gaussian that measures how crowded a pixel's neighbourhood is
+static const float SIGMA = 1.5f;
+// Share of pixels set in the initial pattern
+static const float INITIAL_DENSITY = 0.1f;
+
+namespace {
+
+// Gaussian energy of a set of pixels on a torus, kept up to date as pixels
+// are added and removed
+class EnergyField {
+public:
+    explicit EnergyField(unsigned int size) : m_Size(size), m_Energy(size * size, 0.0f), m_Kernel(size * size) {
+        // Kernel by wrapped offset, so the tile is seamless
+        for (unsigned int y = 0; y < size; ++y) {
+            for (unsigned int x = 0; x < size; ++x) {
+                float dx = static_cast<float>(std::min(x, size - x));
+                float dy = static_cast<float>(std::min(y, size - y));
+                m_Kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * SIGMA * SIGMA));
+            }
+        }
+    }
+
+    void Splat(unsigned int index, float sign) {
+        unsigned int px = index % m_Size, py = index / m_Size;
+        for (unsigned int y = 0; y < m_Size; ++y) {
+            unsigned int ky = (y + m_Size - py) % m_Size;
+            for (unsigned int x = 0; x < m_Size; ++x) {
+                unsigned int kx = (x + m_Size - px) % m_Size;
+                m_Energy[y * m_Size + x] += sign * m_Kernel[ky * m_Size + kx];
+            }
+        }
+    }
+
+    // Most crowded set pixel (tightest cluster) or emptiest unset pixel
+    // (largest void)
+    unsigned int Find(const std::vector<uint8_t>& pattern, uint8_t value, bool highest) const {
+        unsigned int best = 0;
+        float bestEnergy = highest ? -1.0f : 1e30f;
+        for (unsigned int i = 0; i < pattern.size(); ++i) {
+            if (pattern[i] != value) {
+                continue;
+            }
+            if (highest ? m_Energy[i] > bestEnergy : m_Energy[i] < bestEnergy) {
+                bestEnergy = m_Energy[i];
+                best = i;
+            }
+        }
+        return best;
+    }
+
+private:
+    unsigned int m_Size;
+    std::vector<float> m_Energy;
+    std::vector<float> m_Kernel;
+};
+
+} // namespace
+
+std::vector<uint8_t> BlueNoise::Generate(unsigned int size) {
+    unsigned int count = size * size;
+    std::vector<uint8_t> pattern(count, 0);
+    EnergyField field(size);
+
+    // Initial binary pattern: random points, then relaxed by moving the
+    // tightest cluster into the largest void until that stops changing
+    std::mt19937 random(1);
+    unsigned int ones = std::max(1u, static_cast<unsigned int>(count * INITIAL_DENSITY));
+    for (unsigned int placed = 0; placed < ones;) {
+        unsigned int i = random() % count;
+        if (!pattern[i]) {
+            pattern[i] = 1;
+            field.Splat(i, 1.0f);
+            ++placed;
+        }
+    }
+    // Capped in case it ends up swapping between two states
+    for (unsigned int step = 0; step < count; ++step) {
+        unsigned int cluster = field.Find(pattern, 1, true);
+        pattern[cluster] = 0;
+        field.Splat(cluster, -1.0f);
+        unsigned int voidIndex = field.Find(pattern, 0, false);
+        pattern[voidIndex] = 1;
+        field.Splat(voidIndex, 1.0f);
+        if (voidIndex == cluster) {
+            break;
+        }
+    }
+
+    std::vector<unsigned int> rank(count);
+
+    // Phase 1: rank the initial points by removing tightest clusters
+    {
+        std::vector<uint8_t> working = pattern;
+        EnergyField workingField = field;
+        for (unsigned int r = ones; r-- > 0;) {
+            unsigned int cluster = workingField.Find(working, 1, true);
+            working[cluster] = 0;
+            workingField.Splat(cluster, -1.0f);
+            rank[cluster] = r;
+        }
+    }
+
+    // Phase 2: rank the rest by filling largest voids
+    for (unsigned int r = ones; r < count; ++r) {
+        unsigned int voidIndex = field.Find(pattern, 0, false);
+        pattern[voidIndex] = 1;
+        field.Splat(voidIndex, 1.0f);
+        rank[voidIndex] = r;
+    }
+
+    std::vector<uint8_t> values(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        values[i] = static_cast<uint8_t>((rank[i] * 256u) / count);
+    }
+    return values;
+}
@@ -1,5 +1,10 @@
 #include "rendering/CRTShader.h"
+#include "rendering/GLState.h"
+#include "rendering/BlueNoise.h"
 #include <iostream>
+#include <string>
+#include <cmath>
+#include <algorithm>
 #include <GLFW/glfw3.h>
 
 // CRT Post-processing shader
@@ -17,26 +22,38 @@ void main()
 }
 )";
 
-const char* crtFragmentShader = R"(
+// Effect parameters, shared by every post-process pass. Must match
+// CRTParameters below.
+const char* crtParametersBlock = R"(
+layout (std140) uniform CRTParameters {
+    vec2 resolution;
+    float scanlineIntensity;
+    float curvature;
+    float vignetteStrength;
+    float chromaticAberration;
+    float glowIntensity;
+    float noiseAmount;
+};
+)";
+
+// Phosphor persistence: the previous frame, decayed, blended onto the new
+// one with GL_MAX so whatever was brighter stays lit
+const char* crtPersistenceShader = R"(
 #version 330 core
 out vec4 FragColor;
 in vec2 TexCoords;
 
-uniform sampler2D screenTexture;
-uniform float time;
-uniform vec2 resolution;
-uniform float scanlineIntensity;
-uniform float curvature;
-uniform float vignetteStrength;
-uniform float chromaticAberration;
-uniform float glowIntensity;
-uniform float noiseAmount;
+uniform sampler2D previousFrame;
+uniform float decay;
 
-// Random noise function
-float random(vec2 co) {
-    return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+void main()
+{
+    FragColor = vec4(texture(previousFrame, TexCoords).rgb * decay, 1.0);
 }
+)";
 
+// Screen geometry, shared by the CRT pass and the warp LUT bake
+const char* crtWarpFunctions = R"(
 // CRT screen curvature
 vec2 curveScreen(vec2 uv, float amount) {
     uv = uv * 2.0 - 1.0;
@@ -46,103 +63,286 @@ vec2 curveScreen(vec2 uv, float amount) {
     return uv;
 }
 
+// Edge darkening at a (curved) screen position
+float vignetteFactor(vec2 uv, float strength) {
+    vec2 vignetteUV = uv * (1.0 - uv.yx);
+    float vignette = vignetteUV.x * vignetteUV.y * 20.0;  // Changed from 15.0 to 20.0 (less dark)
+    return pow(vignette, strength * 0.5);                 // Reduced strength multiplier
+}
+)";
+
+// Bakes the warp LUT: curvature displacement in RG, vignette in B. The
+// displacement rather than the warped position is stored because half
+// floats keep sub-pixel precision near zero but not near 1.0 at 4K.
+const char* crtWarpBakeShader = R"(
+out vec4 FragColor;
+in vec2 TexCoords;
+
+void main()
+{
+    vec2 uv = curveScreen(TexCoords, curvature);
+    FragColor = vec4(uv - TexCoords, vignetteFactor(clamp(uv, 0.0, 1.0), vignetteStrength), 1.0);
+}
+)";
+
+// Fused post-process program. Preceded by the version line, the macros of
+// its passes, the parameter block and the warp functions; followed by the
+// passes' declarations, then main() built from their bodies. Passes that
+// are off are left out, so with everything off this is a single texture
+// fetch.
+const char* crtFusedHeader = R"(
+out vec4 FragColor;
+in vec2 TexCoords;
+
+uniform sampler2D screenTexture;
+uniform float time;
+#if (defined(CURVATURE) || defined(VIGNETTE)) && !defined(DIRECT_WARP)
+#define WARP_LUT
+uniform sampler2D warpTexture;
+#endif
+)";
+
+const char* crtFusedMainBegin = R"(
 void main()
 {
     vec2 uv = TexCoords;
-    
+
+#ifdef WARP_LUT
+    // Curvature and vignette only change with the parameters and the
+    // resolution, so they are baked into a lookup texture
+    vec3 warp = texture(warpTexture, TexCoords).rgb;
+#endif
+)";
+
+// Read of the frame when no sample pass is fused in
+const char* crtFusedDefaultSample = R"(
+    vec3 col = texture(screenTexture, uv).rgb;
+)";
+
+const char* crtFusedMainEnd = R"(
+    // Output final color (removed warm color temperature shift for better visibility)
+    FragColor = vec4(col, 1.0);
+}
+)";
+
+const char* crtCurvaturePass = R"(
     // Apply curvature
-    if (curvature > 0.0) {
-        uv = curveScreen(uv, curvature);
-    }
-    
+#ifdef WARP_LUT
+    uv += warp.xy;
+#else
+    uv = curveScreen(uv, curvature);
+#endif
+
     // Out of bounds check for curved screen
     if (uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0) {
         FragColor = vec4(0.0, 0.0, 0.0, 1.0);
         return;
     }
-    
+)";
+
+const char* crtChromaPass = R"(
     // Chromatic aberration
     vec3 col;
-    if (chromaticAberration > 0.0) {
-        float aberration = chromaticAberration * 0.002;
-        col.r = texture(screenTexture, vec2(uv.x + aberration, uv.y)).r;
-        col.g = texture(screenTexture, uv).g;
-        col.b = texture(screenTexture, vec2(uv.x - aberration, uv.y)).b;
-    } else {
-        col = texture(screenTexture, uv).rgb;
-    }
-    
+    float aberration = chromaticAberration * 0.002;
+    col.r = texture(screenTexture, vec2(uv.x + aberration, uv.y)).r;
+    col.g = texture(screenTexture, uv).g;
+    col.b = texture(screenTexture, vec2(uv.x - aberration, uv.y)).b;
+)";
+
+const char* crtScanlinePass = R"(
     // Scanlines
-    if (scanlineIntensity > 0.0) {
-        float scanline = sin(uv.y * resolution.y * 2.0) * scanlineIntensity;
-        col -= scanline;
-    }
-    
+    float scanline = sin(uv.y * resolution.y * 2.0) * scanlineIntensity;
+    col -= scanline;
+
     // Horizontal scanline roll effect
     float roll = sin(uv.y * 100.0 + time * 2.0) * 0.002;
     col += roll;
-    
+)";
+
+const char* crtVignettePass = R"(
     // Vignette
-    if (vignetteStrength > 0.0) {
-        vec2 vignetteUV = uv * (1.0 - uv.yx);
-        float vignette = vignetteUV.x * vignetteUV.y * 20.0;  // Changed from 15.0 to 20.0 (less dark)
-        vignette = pow(vignette, vignetteStrength * 0.5);     // Reduced strength multiplier
-        col *= vignette;
-    }
-    
-    // Phosphor glow/bloom
-    if (glowIntensity > 0.0) {
-        vec3 glow = texture(screenTexture, uv).rgb * glowIntensity;
-        col += glow * 0.3;
-    }
-    
+#ifdef WARP_LUT
+    col *= warp.z;
+#else
+    col *= vignetteFactor(uv, vignetteStrength);
+#endif
+)";
+
+const char* crtGlowDeclarations = R"(
+uniform sampler2D bloomTexture;
+)";
+
+const char* crtGlowPass = R"(
+    // Phosphor glow: the blurred bright parts of the screen
+    col += texture(bloomTexture, uv).rgb * glowIntensity;
+)";
+
+const char* crtGrainDeclarations = R"(
+// Tiled blue noise, moved by a random whole-texel offset every frame
+uniform sampler2D noiseTexture;
+uniform vec2 noiseOffset;
+)";
+
+const char* crtGrainPass = R"(
     // Screen flicker (reduced intensity)
     float flicker = 0.98 + 0.02 * sin(time * 50.0);  // Changed from 0.95-1.05 to 0.98-1.0
     col *= flicker;
-    
+
     // Random noise/grain
-    if (noiseAmount > 0.0) {
-        float noise = random(uv * time) * noiseAmount;
-        col += noise * 0.1;
+    vec2 noiseUV = (gl_FragCoord.xy + noiseOffset) / vec2(textureSize(noiseTexture, 0));
+    float noise = texture(noiseTexture, noiseUV).r * noiseAmount;
+    col += noise * 0.1;
+)";
+
+// std140 layout of the CRTParameters block: the vec2 takes 8 bytes and
+// the floats pack right after it
+struct CRTParameters {
+    float resolution[2];
+    float scanlineIntensity;
+    float curvature;
+    float vignetteStrength;
+    float chromaticAberration;
+    float glowIntensity;
+    float noiseAmount;
+};
+
+// The governor keeps the measured GPU time of the scene plus post-process
+// under this, leaving the rest of a 60 Hz frame for everything else
+static const double GPU_BUDGET_MS = 12.0;
+// Scale back up only with this much of the budget to spare, so a step up
+// doesn't immediately overshoot
+static const double UPSCALE_HEADROOM = 0.7;
+static const float RENDER_SCALE_STEP = 0.05f;
+// Measured frames between scale changes; each change reallocates targets
+static const unsigned int RESCALE_INTERVAL = 30;
+
+// The warp LUT is this many times smaller than the render target per
+// axis; the warp is smooth enough that bilinear filtering makes up for it
+static const unsigned int WARP_LUT_DOWNSAMPLE = 4;
+// Only three channels are used, but RGB16F doesn't have to be renderable
+// in GL 3.3 core and RGBA16F does
+static const GLenum WARP_LUT_FORMAT = GL_RGBA16F;
+// Draws per path and resolution in Benchmark
+static const unsigned int BENCHMARK_FRAMES = 100;
+
+static const unsigned int SCREEN_UNIT = 0;
+static const unsigned int BLOOM_UNIT = 1;
+static const unsigned int WARP_UNIT = 2;
+static const unsigned int NOISE_UNIT = 3;
+
+// Side of the tiled blue-noise texture
+static const unsigned int NOISE_SIZE = 64;
+// Every time-based effect repeats within this many seconds (the roll
+// after pi, the flicker after pi/25), so time wraps here instead of
+// losing float precision over a long session
+static const double TIME_PERIOD = 3.14159265358979323846;
+
+// Color formats the scene and the intermediate targets can use, by name
+static const struct {
+    const char* name;
+    GLenum format;
+} COLOR_FORMATS[] = {
+    {"rgba8", GL_RGBA8},
+    {"rgb10a2", GL_RGB10_A2},
+    {"srgb", GL_SRGB8_ALPHA8},
+};
+
+// A window resize only reaches the render targets once the window has kept
+// its size this long; during a drag the old targets are stretched instead
+static const double RESIZE_SETTLE_SECONDS = 0.1;
+
+// The post-process stack. Persistence works on the scene as drawn and the
+// bloom reads it as persistence left it; the rest fuses into one program.
+const CRTShader::Pass CRTShader::PASSES[] = {
+    {"persistence", CRT_PERSISTENCE, PassKind::BARRIER, nullptr, nullptr, nullptr, &CRTShader::RunPersistence},
+    {"bloom", CRT_GLOW, PassKind::SIDE, nullptr, nullptr, nullptr, &CRTShader::RunBloom},
+    {"curvature", CRT_CURVATURE, PassKind::COORDINATE, "CURVATURE", nullptr, crtCurvaturePass, nullptr},
+    {"chroma", CRT_CHROMATIC_ABERRATION, PassKind::SAMPLE, "CHROMATIC_ABERRATION", nullptr, crtChromaPass, nullptr},
+    {"scanlines", CRT_SCANLINES, PassKind::COLOR, "SCANLINES", nullptr, crtScanlinePass, nullptr},
+    {"vignette", CRT_VIGNETTE, PassKind::COLOR, "VIGNETTE", nullptr, crtVignettePass, nullptr},
+    {"glow", CRT_GLOW, PassKind::COLOR, "GLOW", crtGlowDeclarations, crtGlowPass, nullptr},
+    {"grain", CRT_NOISE, PassKind::COLOR, "NOISE", crtGrainDeclarations, crtGrainPass, nullptr},
+};
+
+std::string CRTShader::GetPassNames() const {
+    std::string names;
+    for (const Pass& pass : PASSES) {
+        if (m_EffectMask & pass.effect) {
+            names += names.empty() ? pass.name : std::string(", ") + pass.name;
+        }
     }
-    
-    // Output final color (removed warm color temperature shift for better visibility)
-    FragColor = vec4(col, 1.0);
+    return names.empty() ? "none" : names;
+}
+
+bool CRTShader::IsFused(PassKind kind) {
+    return kind == PassKind::COORDINATE || kind == PassKind::SAMPLE || kind == PassKind::COLOR;
+}
+
+const char* CRTShader::GetParametersBlockSource() {
+    return crtParametersBlock;
 }
-)";
 
-CRTShader::CRTShader() 
-    : m_FBO(0), m_TextureColorbuffer(0), m_RBO(0), 
-      m_QuadVAO(0), m_QuadVBO(0), m_ShaderProgram(0),
-      m_Width(0), m_Height(0), m_Time(0.0f),
+CRTShader::CRTShader()
+    : m_Scene(nullptr), m_History(nullptr), m_Post(nullptr), m_Warp(nullptr),
+      m_QuadVAO(0), m_QuadVBO(0),
+      m_WarpCurvature(0.0f), m_WarpVignette(0.0f), m_WarpDirty(true), m_NoiseTexture(0),
+      m_PersistenceDecayLocation(-1), m_GlowAvailable(true), m_BloomTexture(0),
+      m_EffectMask(0), m_PassCount(0),
+      m_ParametersBuffer(0), m_ParametersDirty(true),
+      m_ColorFormat(GL_RGBA8), m_TargetsDirty(false), m_ResizePending(false), m_ResizeTime(0.0),
+      m_Width(0), m_Height(0), m_VirtualWidth(0), m_VirtualHeight(0), m_RenderWidth(0), m_RenderHeight(0), m_Time(0.0f),
+      m_LastFrameTime(0.0), m_FrameSeconds(0.0f), m_FrameIndex(0), m_HistoryFrame(0),
+      m_RenderScale(1.0f), m_AutoQuality(true), m_GPUTime(0.0), m_FramesSinceRescale(0),
       m_ScanlineIntensity(0.03f), m_Curvature(0.05f),     // Reduced from 0.08 and 0.15
       m_VignetteStrength(0.15f), m_ChromaticAberration(0.3f), // Reduced from 0.4 and 1.0
-      m_GlowIntensity(0.1f), m_NoiseAmount(0.02f), m_Enabled(true) { // Reduced from 0.2 and 0.05
+      m_GlowIntensity(0.1f), m_NoiseAmount(0.02f), m_Persistence(0.0f), m_Enabled(true) { // Reduced from 0.2 and 0.05
 }
 
 CRTShader::~CRTShader() {
-    if (m_FBO) glDeleteFramebuffers(1, &m_FBO);
-    if (m_TextureColorbuffer) glDeleteTextures(1, &m_TextureColorbuffer);
-    if (m_RBO) glDeleteRenderbuffers(1, &m_RBO);
-    if (m_QuadVAO) glDeleteVertexArrays(1, &m_QuadVAO);
-    if (m_QuadVBO) glDeleteBuffers(1, &m_QuadVBO);
-    if (m_ShaderProgram) glDeleteProgram(m_ShaderProgram);
+    // The pool deletes the targets themselves
+    if (m_QuadVAO) GLState::DeleteVertexArray(m_QuadVAO);
+    if (m_QuadVBO) GLState::DeleteBuffer(m_QuadVBO);
+    if (m_ParametersBuffer) GLState::DeleteBuffer(m_ParametersBuffer);
+    if (m_NoiseTexture) GLState::DeleteTexture(m_NoiseTexture);
 }
 
 bool CRTShader::Initialize(unsigned int width, unsigned int height) {
     m_Width = width;
     m_Height = height;
-    
+    unsigned int baseWidth = m_VirtualWidth ? m_VirtualWidth : width;
+    unsigned int baseHeight = m_VirtualHeight ? m_VirtualHeight : height;
+    m_RenderWidth = std::max(1u, static_cast<unsigned int>(baseWidth * m_RenderScale));
+    m_RenderHeight = std::max(1u, static_cast<unsigned int>(baseHeight * m_RenderScale));
+
     if (!CreateShader()) {
         return false;
     }
-    
-    if (!CreateFramebuffer()) {
+
+    if (!AcquireTargets()) {
         return false;
     }
-    
+
+    if (!m_Bloom.Initialize(m_RenderWidth, m_RenderHeight, &m_Pool)) {
+        return false;
+    }
+    SetGlowAvailable(m_Bloom.HasLevels());
+
+    // Grain: generated once, then only offset per frame
+    std::vector<uint8_t> noise = BlueNoise::Generate(NOISE_SIZE);
+    glGenTextures(1, &m_NoiseTexture);
+    GLState::BindTexture(NOISE_UNIT, GL_TEXTURE_2D, m_NoiseTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, NOISE_SIZE, NOISE_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, noise.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    // Without timer queries the governor just never moves
+    m_Timer.Initialize();
+
     SetupQuad();
-    
+
     std::cout << "CRT Shader initialized successfully" << std::endl;
     return true;
 }
@@ -150,90 +350,351 @@ bool CRTShader::Initialize(unsigned int width, unsigned int height) {
 void CRTShader::Resize(unsigned int width, unsigned int height) {
     m_Width = width;
     m_Height = height;
-    
-    // Recreate framebuffer with new size
-    if (m_FBO) glDeleteFramebuffers(1, &m_FBO);
-    if (m_TextureColorbuffer) glDeleteTextures(1, &m_TextureColorbuffer);
-    if (m_RBO) glDeleteRenderbuffers(1, &m_RBO);
-    
-    CreateFramebuffer();
+
+    // A drag-resize fires this for every mouse move. The targets are only
+    // recreated once the size settles; at a virtual resolution they don't
+    // depend on the window at all.
+    if (m_VirtualWidth == 0) {
+        m_ResizePending = true;
+        m_ResizeTime = glfwGetTime();
+    }
 }
 
-bool CRTShader::CreateFramebuffer() {
-    // Generate framebuffer
-    glGenFramebuffers(1, &m_FBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
-    
-    // Create texture attachment
-    glGenTextures(1, &m_TextureColorbuffer);
-    glBindTexture(GL_TEXTURE_2D, m_TextureColorbuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_Width, m_Height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_TextureColorbuffer, 0);
-    
-    // Create renderbuffer for depth and stencil
-    glGenRenderbuffers(1, &m_RBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_RBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_Width, m_Height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_RBO);
-    
-    // Check framebuffer completeness
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "ERROR: Framebuffer is not complete!" << std::endl;
-        return false;
+void CRTShader::SetVirtualResolution(unsigned int width, unsigned int height) {
+    if (width == 0 || height == 0) {
+        width = height = 0;
     }
-    
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    return true;
+    m_VirtualWidth = width;
+    m_VirtualHeight = height;
+    m_TargetsDirty = true;
+}
+
+bool CRTShader::NeedsPostTarget() const {
+    return m_VirtualWidth != 0 || m_RenderWidth != m_Width || m_RenderHeight != m_Height;
+}
+
+void CRTShader::SetAutoQuality(bool enabled) {
+    m_AutoQuality = enabled;
+    m_FramesSinceRescale = 0;
+}
+
+void CRTShader::SetRenderScale(float scale) {
+    m_AutoQuality = false;
+    m_RenderScale = std::max(MIN_RENDER_SCALE, std::min(scale, 1.0f));
+    m_TargetsDirty = true;
+}
+
+bool CRTShader::SetColorFormat(const std::string& name) {
+    for (const auto& entry : COLOR_FORMATS) {
+        if (name != entry.name) {
+            continue;
+        }
+        if (entry.format == GL_SRGB8_ALPHA8) {
+            // Passes read the scene decoded to linear, so the window has to
+            // encode their output again or everything comes out dark
+            GLint encoding = GL_LINEAR;
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT,
+                                                  GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+            if (encoding != GL_SRGB) {
+                std::cerr << "ERROR: Window framebuffer is not sRGB-capable" << std::endl;
+                return false;
+            }
+        }
+        m_ColorFormat = entry.format;
+        m_TargetsDirty = true;
+        return true;
+    }
+    return false;
+}
+
+const char* CRTShader::GetColorFormatName() const {
+    for (const auto& entry : COLOR_FORMATS) {
+        if (entry.format == m_ColorFormat) {
+            return entry.name;
+        }
+    }
+    return COLOR_FORMATS[0].name;
+}
+
+bool CRTShader::IsAnimating() const {
+    return m_Enabled && (m_ResizePending || (m_EffectMask & (CRT_SCANLINES | CRT_NOISE | CRT_PERSISTENCE)));
+}
+
+void CRTShader::ApplyPendingChanges() {
+    // Mid-resize: keep the old targets and let the final composite stretch
+    // them over the window, which only needs the upscale target
+    if (m_ResizePending) {
+        if (glfwGetTime() - m_ResizeTime < RESIZE_SETTLE_SECONDS) {
+            if (!m_Post && NeedsPostTarget()) {
+                m_Post = m_Pool.Acquire(m_RenderWidth, m_RenderHeight, m_ColorFormat);
+            }
+            return;
+        }
+        m_ResizePending = false;
+        m_TargetsDirty = true;
+    }
+
+    if (m_TargetsDirty) {
+        m_TargetsDirty = false;
+        UpdateRenderSize();
+    }
+}
+
+void CRTShader::UpdateRenderSize() {
+    unsigned int baseWidth = m_VirtualWidth ? m_VirtualWidth : m_Width;
+    unsigned int baseHeight = m_VirtualHeight ? m_VirtualHeight : m_Height;
+    unsigned int width = std::max(1u, static_cast<unsigned int>(baseWidth * m_RenderScale));
+    unsigned int height = std::max(1u, static_cast<unsigned int>(baseHeight * m_RenderScale));
+    bool sizeChanged = width != m_RenderWidth || height != m_RenderHeight;
+    m_RenderWidth = width;
+    m_RenderHeight = height;
+    if (sizeChanged) {
+        m_ParametersDirty = true;  // Scanlines follow the internal resolution
+    }
+
+    if (!m_Scene) {
+        return;  // Not initialized yet
+    }
+    if (!sizeChanged && m_Scene->format == m_ColorFormat && (m_Post != nullptr) == NeedsPostTarget()) {
+        return;
+    }
+
+    // Build the new targets before letting go of the old ones, so a failed
+    // allocation leaves the CRT pass running as it was rather than off
+    RenderTarget* previous[] = {m_Scene, m_History, m_Post, m_Warp};
+    m_Scene = m_History = m_Post = m_Warp = nullptr;
+    if (AcquireTargets()) {
+        for (RenderTarget* target : previous) {
+            m_Pool.Release(target);
+        }
+        SetGlowAvailable(m_Bloom.Resize(m_RenderWidth, m_RenderHeight));
+    } else {
+        std::cerr << "ERROR: Failed to create " << m_RenderWidth << "x" << m_RenderHeight
+                  << " CRT render targets, keeping the previous ones" << std::endl;
+        ReleaseTargets();
+        m_Scene = previous[0];
+        m_History = previous[1];
+        m_Post = previous[2];
+        m_Warp = previous[3];
+        m_RenderWidth = m_Scene->width;
+        m_RenderHeight = m_Scene->height;
+        m_ColorFormat = m_Scene->format;
+        m_ParametersDirty = true;
+
+        // The window may have changed size anyway
+        if (!m_Post && NeedsPostTarget()) {
+            m_Post = m_Pool.Acquire(m_RenderWidth, m_RenderHeight, m_ColorFormat);
+        }
+    }
+
+    // Nothing of the other size will be asked for again
+    m_Pool.Trim();
+}
+
+void CRTShader::UpdateQuality() {
+    double milliseconds;
+    if (!m_Timer.Poll(milliseconds)) {
+        return;
+    }
+    m_GPUTime = m_GPUTime > 0.0 ? m_GPUTime * 0.9 + milliseconds * 0.1 : milliseconds;
+
+    if (!m_AutoQuality || ++m_FramesSinceRescale < RESCALE_INTERVAL) {
+        return;
+    }
+
+    float scale = m_RenderScale;
+    if (m_GPUTime > GPU_BUDGET_MS) {
+        // Cost follows the pixel count, which goes with the square of the scale
+        scale *= static_cast<float>(std::sqrt(GPU_BUDGET_MS / m_GPUTime));
+        scale = std::floor(scale / RENDER_SCALE_STEP) * RENDER_SCALE_STEP;
+    } else if (m_GPUTime < GPU_BUDGET_MS * UPSCALE_HEADROOM) {
+        scale += RENDER_SCALE_STEP;
+    }
+    scale = std::max(MIN_RENDER_SCALE, std::min(scale, 1.0f));
+
+    if (std::fabs(scale - m_RenderScale) >= RENDER_SCALE_STEP * 0.5f) {
+        m_RenderScale = scale;
+        m_FramesSinceRescale = 0;
+        m_TargetsDirty = true;
+    }
+}
+
+bool CRTShader::AcquireTargets() {
+    m_Scene = m_Pool.Acquire(m_RenderWidth, m_RenderHeight, m_ColorFormat);
+
+    // Below full resolution or at a virtual resolution the last pass
+    // renders offscreen too, and the result is stretched onto the window
+    if (NeedsPostTarget()) {
+        m_Post = m_Pool.Acquire(m_RenderWidth, m_RenderHeight, m_ColorFormat);
+    }
+
+    m_Warp = m_Pool.Acquire(std::max(1u, m_RenderWidth / WARP_LUT_DOWNSAMPLE),
+                            std::max(1u, m_RenderHeight / WARP_LUT_DOWNSAMPLE), WARP_LUT_FORMAT);
+    m_WarpDirty = true;
+
+    return m_Scene && m_Warp && (m_Post || !NeedsPostTarget());
+}
+
+void CRTShader::ReleaseTargets() {
+    for (RenderTarget* target : {m_Scene, m_History, m_Post, m_Warp}) {
+        m_Pool.Release(target);
+    }
+    m_Scene = m_History = m_Post = m_Warp = nullptr;
+}
+
+void CRTShader::SetPersistence(float persistence) {
+    m_Persistence = std::max(0.0f, std::min(persistence, 0.95f));
+    m_ParametersDirty = true;  // Turns the pass on or off
+}
+
+bool CRTShader::SetGlowPasses(unsigned int passes) {
+    SetGlowAvailable(m_Bloom.SetPasses(passes));
+    m_Pool.Trim();
+    return m_GlowAvailable;
+}
+
+bool CRTShader::SetGlowDownsample(unsigned int divisor) {
+    SetGlowAvailable(m_Bloom.SetDownsample(divisor));
+    m_Pool.Trim();
+    return m_GlowAvailable;
+}
+
+void CRTShader::SetGlowAvailable(bool available) {
+    // Without the bloom targets the composite would sample a stale texture
+    if (available != m_GlowAvailable) {
+        m_GlowAvailable = available;
+        m_ParametersDirty = true;
+    }
+}
+
+void CRTShader::BakeWarpLUT(RenderTarget* target) {
+    // Reads curvature and vignetteStrength from the parameter block, so
+    // it has to be uploaded first
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glViewport(0, 0, target->width, target->height);
+    glDisable(GL_BLEND);
+    m_WarpShader.Use();
+    GLState::BindVertexArray(m_QuadVAO);
+    GLState::DrawArrays(GL_TRIANGLES, 0, 6);
+    glEnable(GL_BLEND);
 }
 
 bool CRTShader::CreateShader() {
-    // Compile vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &crtVertexShader, NULL);
-    glCompileShader(vertexShader);
-    
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "ERROR: CRT Vertex shader compilation failed\n" << infoLog << std::endl;
+    // Build the fused program for the default settings up front, so a
+    // broken shader fails initialization instead of the first frame
+    m_EffectMask = ComputeEffectMask();
+    uint32_t fused = 0;
+    for (const Pass& pass : PASSES) {
+        if (IsFused(pass.kind)) {
+            fused |= pass.effect;
+        }
+    }
+    if (!GetVariant(m_EffectMask & fused)) {
         return false;
     }
-    
-    // Compile fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &crtFragmentShader, NULL);
-    glCompileShader(fragmentShader);
-    
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "ERROR: CRT Fragment shader compilation failed\n" << infoLog << std::endl;
+
+    std::string warpSource = std::string("#version 330 core\n") + crtParametersBlock + crtWarpFunctions + crtWarpBakeShader;
+    if (!m_WarpShader.Create("CRT warp", crtVertexShader, warpSource.c_str())) {
         return false;
     }
-    
-    // Link shader program
-    m_ShaderProgram = glCreateProgram();
-    glAttachShader(m_ShaderProgram, vertexShader);
-    glAttachShader(m_ShaderProgram, fragmentShader);
-    glLinkProgram(m_ShaderProgram);
-    
-    glGetProgramiv(m_ShaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(m_ShaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR: CRT Shader program linking failed\n" << infoLog << std::endl;
+    m_WarpShader.BindUniformBlock("CRTParameters", PARAMETERS_BINDING);
+
+    if (!m_PersistenceShader.Create("CRT persistence", crtVertexShader, crtPersistenceShader)) {
         return false;
     }
-    
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    
+    m_PersistenceDecayLocation = m_PersistenceShader.GetUniformLocation("decay");
+    m_PersistenceShader.Use();
+    glUniform1i(m_PersistenceShader.GetUniformLocation("previousFrame"), SCREEN_UNIT);
+
+    // Attached to its binding point once; EndRender only rewrites it
+    glGenBuffers(1, &m_ParametersBuffer);
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, m_ParametersBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CRTParameters), NULL, GL_DYNAMIC_DRAW);
+    GLState::BindBufferBase(GL_UNIFORM_BUFFER, PARAMETERS_BINDING, m_ParametersBuffer);
+    m_ParametersDirty = true;
+
     return true;
 }
 
+uint32_t CRTShader::ComputeEffectMask() const {
+    uint32_t mask = 0;
+    if (m_Curvature > 0.0f) mask |= CRT_CURVATURE;
+    if (m_ChromaticAberration > 0.0f) mask |= CRT_CHROMATIC_ABERRATION;
+    if (m_ScanlineIntensity > 0.0f) mask |= CRT_SCANLINES;
+    if (m_VignetteStrength > 0.0f) mask |= CRT_VIGNETTE;
+    if (m_GlowIntensity > 0.0f && m_GlowAvailable) mask |= CRT_GLOW;
+    if (m_NoiseAmount > 0.0f) mask |= CRT_NOISE;
+    if (m_Persistence > 0.0f) mask |= CRT_PERSISTENCE;
+    return mask;
+}
+
+CRTShader::Variant* CRTShader::GetVariant(uint32_t effectMask) {
+    auto it = m_Variants.find(effectMask);
+    if (it != m_Variants.end()) {
+        return it->second.shader ? &it->second : nullptr;
+    }
+
+    // Only fused passes contribute; side and barrier passes share bits
+    // with some of them but have no code here
+    std::string fragmentSource = "#version 330 core\n";
+    for (const Pass& pass : PASSES) {
+        if (IsFused(pass.kind) && (effectMask & pass.effect)) {
+            fragmentSource += std::string("#define ") + pass.define + "\n";
+        }
+    }
+    if (effectMask & CRT_DIRECT_WARP) {
+        fragmentSource += "#define DIRECT_WARP\n";
+    }
+    fragmentSource += crtParametersBlock;
+    fragmentSource += crtWarpFunctions;
+    fragmentSource += crtFusedHeader;
+    for (const Pass& pass : PASSES) {
+        if (IsFused(pass.kind) && (effectMask & pass.effect) && pass.declarations) {
+            fragmentSource += pass.declarations;
+        }
+    }
+
+    // Bodies by kind, in stack order within each: where to read, the
+    // read itself, then what to do with the color
+    fragmentSource += crtFusedMainBegin;
+    bool sampled = false;
+    for (PassKind kind : {PassKind::COORDINATE, PassKind::SAMPLE, PassKind::COLOR}) {
+        for (const Pass& pass : PASSES) {
+            if (pass.kind == kind && (effectMask & pass.effect)) {
+                fragmentSource += pass.body;
+                sampled = sampled || kind == PassKind::SAMPLE;
+            }
+        }
+        if (kind == PassKind::SAMPLE && !sampled) {
+            fragmentSource += crtFusedDefaultSample;
+        }
+    }
+    fragmentSource += crtFusedMainEnd;
+
+    // Failures are cached too, so a broken variant is only attempted once
+    Variant& variant = m_Variants[effectMask];
+    variant.timeLocation = -1;
+    variant.noiseOffsetLocation = -1;
+    std::unique_ptr<ShaderProgram> shader = std::make_unique<ShaderProgram>();
+    if (!shader->Create("CRT", crtVertexShader, fragmentSource.c_str())) {
+        return nullptr;
+    }
+
+    // Variants without time-based effects have no time uniform
+    variant.timeLocation = shader->GetUniformLocation("time");
+    variant.noiseOffsetLocation = shader->GetUniformLocation("noiseOffset");
+    shader->BindUniformBlock("CRTParameters", PARAMETERS_BINDING);
+    shader->Use();
+    glUniform1i(shader->GetUniformLocation("screenTexture"), SCREEN_UNIT);
+    glUniform1i(shader->GetUniformLocation("bloomTexture"), BLOOM_UNIT);
+    glUniform1i(shader->GetUniformLocation("warpTexture"), WARP_UNIT);
+    glUniform1i(shader->GetUniformLocation("noiseTexture"), NOISE_UNIT);
+
+    variant.shader = std::move(shader);
+    return &variant;
+}
+
 void CRTShader::SetupQuad() {
     float quadVertices[] = {
         // positions   // texCoords
@@ -248,8 +709,8 @@ void CRTShader::SetupQuad() {
     
     glGenVertexArrays(1, &m_QuadVAO);
     glGenBuffers(1, &m_QuadVBO);
-    glBindVertexArray(m_QuadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_QuadVBO);
+    GLState::BindVertexArray(m_QuadVAO);
+    GLState::BindBuffer(GL_ARRAY_BUFFER, m_QuadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
@@ -257,43 +718,299 @@ void CRTShader::SetupQuad() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 }
 
+void CRTShader::UploadParameters() {
+    CRTParameters parameters;
+    parameters.resolution[0] = static_cast<float>(m_RenderWidth);
+    parameters.resolution[1] = static_cast<float>(m_RenderHeight);
+    parameters.scanlineIntensity = m_ScanlineIntensity;
+    parameters.curvature = m_Curvature;
+    parameters.vignetteStrength = m_VignetteStrength;
+    parameters.chromaticAberration = m_ChromaticAberration;
+    parameters.glowIntensity = m_GlowIntensity;
+    parameters.noiseAmount = m_NoiseAmount;
+
+    GLState::BindBuffer(GL_UNIFORM_BUFFER, m_ParametersBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(parameters), &parameters);
+    m_ParametersDirty = false;
+}
+
 void CRTShader::BeginRender() {
-    if (!m_Enabled) return;
-    glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!UsesScene()) return;
+    ApplyPendingChanges();
+    if (m_Enabled) {
+        m_Timer.Begin();
+    }
+
+    // sRGB targets encode on write and decode on read, so everything up to
+    // the window works in linear light. The inputs are decoded to match
+    // (see IsSceneSRGB), so the window's encode restores authored colors.
+    if (IsSceneSRGB()) {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_Scene->framebuffer);
+    glViewport(0, 0, m_RenderWidth, m_RenderHeight);
+    glClear(GL_COLOR_BUFFER_BIT);
 }
 
 void CRTShader::EndRender() {
-    if (!m_Enabled) return;
-    
-    // Bind default framebuffer
+    if (!UsesScene()) return;
+
+    // Effects off at a virtual resolution: just the scaled composite
+    if (!m_Enabled) {
+        BlitToWindow(m_Scene);
+        glViewport(0, 0, m_Width, m_Height);
+        glDisable(GL_FRAMEBUFFER_SRGB);
+        return;
+    }
+
+    // Parameters only change through the setters, and with them the set
+    // of passes that run
+    if (m_ParametersDirty) {
+        UploadParameters();
+        m_EffectMask = ComputeEffectMask();
+        if (m_Curvature != m_WarpCurvature || m_VignetteStrength != m_WarpVignette) {
+            m_WarpDirty = true;
+        }
+    }
+
+    double now = glfwGetTime();
+    m_FrameSeconds = static_cast<float>(std::min(now - m_LastFrameTime, 1.0));
+    m_LastFrameTime = now;
+    ++m_FrameIndex;
+    m_PassCount = 0;
+    m_BloomTexture = 0;
+
+    if ((m_EffectMask & (CRT_CURVATURE | CRT_VIGNETTE)) && m_WarpDirty) {
+        BakeWarpLUT(m_Warp);
+        m_WarpCurvature = m_Curvature;
+        m_WarpVignette = m_VignetteStrength;
+        m_WarpDirty = false;
+    }
+
+    // Walk the stack. Fused passes pile up until a barrier needs the frame
+    // itself, or until the next one can't go after them in the same
+    // program (a second read, or a read after the color work started).
+    RenderTarget* frame = m_Scene;
+    uint32_t pending = 0;
+    PassKind stage = PassKind::COORDINATE;
+    for (const Pass& pass : PASSES) {
+        if (!(m_EffectMask & pass.effect)) {
+            continue;
+        }
+        if (IsFused(pass.kind)) {
+            if (pending && (pass.kind < stage || (pass.kind == stage && pass.kind == PassKind::SAMPLE))) {
+                frame = Flush(pending, frame);
+                pending = 0;
+            }
+            pending |= pass.effect;
+            stage = pass.kind;
+            continue;
+        }
+        if (pass.kind == PassKind::BARRIER && pending) {
+            frame = Flush(pending, frame);
+            pending = 0;
+        }
+        (this->*pass.run)(frame);
+    }
+
+    // The last run goes to the window, or to the target that is upscaled
+    // onto it. It also runs with nothing pending, to copy the frame out.
+    DrawFused(pending, frame, m_Post ? m_Post->framebuffer : 0);
+
+    if (m_Post) {
+        BlitToWindow(m_Post);
+    }
+    glViewport(0, 0, m_Width, m_Height);
+
+    // Intermediates go back to the pool, unless persistence kept one
+    for (RenderTarget* target : m_FrameTargets) {
+        if (target != m_History) {
+            m_Pool.Release(target);
+        }
+    }
+    m_FrameTargets.clear();
+    glDisable(GL_FRAMEBUFFER_SRGB);
+
+    m_Timer.End();
+    UpdateQuality();
+}
+
+void CRTShader::BlitToWindow(RenderTarget* source) {
+    // Final composite: stretch the internal image over the window. A
+    // virtual resolution keeps its aspect ratio, with black bars around it.
+    int x0 = 0, y0 = 0, x1 = m_Width, y1 = m_Height;
+    if (m_VirtualWidth) {
+        float scale = std::min(static_cast<float>(m_Width) / m_VirtualWidth,
+                               static_cast<float>(m_Height) / m_VirtualHeight);
+        int width = static_cast<int>(m_VirtualWidth * scale);
+        int height = static_cast<int>(m_VirtualHeight * scale);
+        x0 = (static_cast<int>(m_Width) - width) / 2;
+        y0 = (static_cast<int>(m_Height) - height) / 2;
+        x1 = x0 + width;
+        y1 = y0 + height;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source->framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_Width, m_Height);
+    if (x0 > 0 || y0 > 0) {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glBlitFramebuffer(0, 0, m_RenderWidth, m_RenderHeight, x0, y0, x1, y1,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    // Use CRT shader
-    glUseProgram(m_ShaderProgram);
-    
+}
+
+RenderTarget* CRTShader::Flush(uint32_t effectMask, RenderTarget* frame) {
+    RenderTarget* target = m_Pool.Acquire(m_RenderWidth, m_RenderHeight, m_ColorFormat);
+    if (!target) {
+        return frame;  // Skip these passes rather than lose the frame
+    }
+    m_FrameTargets.push_back(target);
+    DrawFused(effectMask, frame, target->framebuffer);
+    return target;
+}
+
+void CRTShader::DrawFused(uint32_t effectMask, RenderTarget* source, unsigned int framebuffer) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, m_RenderWidth, m_RenderHeight);
+
+    // Fall back to the plain copy if this combination won't build
+    Variant* variant = GetVariant(effectMask);
+    if (!variant) {
+        effectMask = 0;
+        variant = GetVariant(effectMask);
+    }
+    if (!variant) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        return;
+    }
+
+    variant->shader->Use();
+
     // Update time
-    m_Time = static_cast<float>(glfwGetTime());
-    
-    // Set uniforms
-    glUniform1f(glGetUniformLocation(m_ShaderProgram, "time"), m_Time);
-    glUniform2f(glGetUniformLocation(m_ShaderProgram, "resolution"), 
-                static_cast<float>(m_Width), static_cast<float>(m_Height));
-    glUniform1f(glGetUniformLocation(m_ShaderProgram, "scanlineIntensity"), m_ScanlineIntensity);
-    glUniform1f(glGetUniformLocation(m_ShaderProgram, "curvature"), m_Curvature);
-    glUniform1f(glGetUniformLocation(m_ShaderProgram, "vignetteStrength"), m_VignetteStrength);
-    glUniform1f(glGetUniformLocation(m_ShaderProgram, "chromaticAberration"), m_ChromaticAberration);
-    glUniform1f(glGetUniformLocation(m_ShaderProgram, "glowIntensity"), m_GlowIntensity);
-    glUniform1f(glGetUniformLocation(m_ShaderProgram, "noiseAmount"), m_NoiseAmount);
-    
-    // Bind texture
-    glBindVertexArray(m_QuadVAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_TextureColorbuffer);
-    
+    m_Time = static_cast<float>(std::fmod(glfwGetTime(), TIME_PERIOD));
+
+    // Set uniforms: only time and the noise offset change every frame
+    if (variant->timeLocation >= 0) {
+        glUniform1f(variant->timeLocation, m_Time);
+    }
+    if (variant->noiseOffsetLocation >= 0) {
+        glUniform2f(variant->noiseOffsetLocation,
+                    static_cast<float>(m_NoiseRandom() % NOISE_SIZE),
+                    static_cast<float>(m_NoiseRandom() % NOISE_SIZE));
+        GLState::BindTexture(NOISE_UNIT, GL_TEXTURE_2D, m_NoiseTexture);
+    }
+
+    // Bind textures
+    GLState::BindVertexArray(m_QuadVAO);
+    if ((effectMask & CRT_GLOW) && m_BloomTexture) {
+        GLState::BindTexture(BLOOM_UNIT, GL_TEXTURE_2D, m_BloomTexture);
+    }
+    if (effectMask & (CRT_CURVATURE | CRT_VIGNETTE)) {
+        GLState::BindTexture(WARP_UNIT, GL_TEXTURE_2D, m_Warp->texture);
+    }
+    GLState::BindTexture(SCREEN_UNIT, GL_TEXTURE_2D, source->texture);
+
     // Draw quad
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    
-    glBindVertexArray(0);
+    GLState::DrawArrays(GL_TRIANGLES, 0, 6);
+    ++m_PassCount;
+}
+
+void CRTShader::RunPersistence(RenderTarget*& frame) {
+    // Last frame's result, decayed, stays lit wherever it is brighter than
+    // the new one. The decay is defined per 1/60 s, so trails last as long
+    // at any frame rate. A history older than one frame is stale.
+    if (m_History && m_HistoryFrame + 1 == m_FrameIndex) {
+        glBindFramebuffer(GL_FRAMEBUFFER, frame->framebuffer);
+        glViewport(0, 0, m_RenderWidth, m_RenderHeight);
+        m_PersistenceShader.Use();
+        glUniform1f(m_PersistenceDecayLocation, std::pow(m_Persistence, m_FrameSeconds * 60.0f));
+        GLState::BindVertexArray(m_QuadVAO);
+        GLState::BindTexture(SCREEN_UNIT, GL_TEXTURE_2D, m_History->texture);
+        glBlendEquation(GL_MAX);
+        GLState::DrawArrays(GL_TRIANGLES, 0, 6);
+        glBlendEquation(GL_FUNC_ADD);
+        ++m_PassCount;
+    }
+
+    // This frame becomes the next one's history. When it is the scene
+    // target, the scene moves to the old history target, so the two
+    // alternate without allocating.
+    RenderTarget* previous = m_History;
+    m_History = frame;
+    m_HistoryFrame = m_FrameIndex;
+    if (frame == m_Scene) {
+        m_Scene = previous ? previous : m_Pool.Acquire(m_RenderWidth, m_RenderHeight, m_ColorFormat);
+        if (!m_Scene) {
+            m_Scene = frame;  // Out of memory: persistence just stops
+            m_History = nullptr;
+        }
+    } else {
+        m_Pool.Release(previous);
+    }
+}
+
+void CRTShader::RunBloom(RenderTarget*& frame) {
+    // Blur the bright parts at reduced resolution for the glow
+    m_BloomTexture = m_Bloom.Render(frame->texture);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    unsigned int levels = m_Bloom.GetLevelCount();
+    m_PassCount += levels ? levels * 2 - 1 : 0;
+}
+
+bool CRTShader::Benchmark(unsigned int width, unsigned int height, double& lutMilliseconds, double& directMilliseconds) {
+    // Only the two effects the LUT replaces, so nothing else dilutes the
+    // difference
+    Variant* lutVariant = GetVariant(CRT_CURVATURE | CRT_VIGNETTE);
+    Variant* directVariant = GetVariant(CRT_CURVATURE | CRT_VIGNETTE | CRT_DIRECT_WARP);
+    GPUTimer timer;
+    if (!lutVariant || !directVariant || !m_Scene || !timer.Initialize()) {
+        return false;
+    }
+    if (m_ParametersDirty) {
+        UploadParameters();
+        m_EffectMask = ComputeEffectMask();
+    }
+
+    // Output target and LUT at the benchmark size
+    RenderTarget* warp = m_Pool.Acquire(std::max(1u, width / WARP_LUT_DOWNSAMPLE),
+                                        std::max(1u, height / WARP_LUT_DOWNSAMPLE), WARP_LUT_FORMAT);
+    RenderTarget* output = m_Pool.Acquire(width, height, m_ColorFormat);
+    bool ok = warp && output;
+
+    if (ok) {
+        BakeWarpLUT(warp);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, output->framebuffer);
+        glViewport(0, 0, width, height);
+        GLState::BindVertexArray(m_QuadVAO);
+        GLState::BindTexture(SCREEN_UNIT, GL_TEXTURE_2D, m_Scene->texture);
+        GLState::BindTexture(WARP_UNIT, GL_TEXTURE_2D, warp->texture);
+
+        Variant* variants[] = {lutVariant, directVariant};
+        double* results[] = {&lutMilliseconds, &directMilliseconds};
+        for (int i = 0; i < 2 && ok; ++i) {
+            variants[i]->shader->Use();
+            GLState::DrawArrays(GL_TRIANGLES, 0, 6);  // Warm up
+
+            timer.Begin();
+            for (unsigned int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+                GLState::DrawArrays(GL_TRIANGLES, 0, 6);
+            }
+            timer.End();
+            glFinish();
+
+            double milliseconds = 0.0;
+            ok = timer.Poll(milliseconds);
+            *results[i] = milliseconds / BENCHMARK_FRAMES;
+        }
+    }
+
+    // Don't keep 4K targets around
+    m_Pool.Release(warp);
+    m_Pool.Release(output);
+    m_Pool.Trim();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_Width, m_Height);
+    return ok;
 }
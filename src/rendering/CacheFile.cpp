@@ -0,0 +1,104 @@
+#include "rendering/CacheFile.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <cstring>
+
+static const char CACHE_DIRECTORY[] = "cache";
+
+// Files are only ever read back on the machine that wrote them, so headers
+// and records are stored in native layout
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+};
+
+uint64_t CacheFile::Hash(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+std::string CacheFile::GetPath(const char* prefix, uint64_t key) {
+    std::ostringstream path;
+    path << CACHE_DIRECTORY << '/' << prefix << '-' << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return path.str();
+}
+
+bool CacheFile::Read(const std::string& path, uint32_t magic, uint32_t version, uint64_t key,
+                     const char* what, std::vector<char>& payload) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // Slurp the whole file in one read, then check it in memory
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(data.data(), data.size())) {
+        return false;
+    }
+
+    FileHeader header;
+    if (data.size() < sizeof(header)) {
+        std::cerr << "Ignoring truncated " << what << ": " << path << std::endl;
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != magic || header.version != version || header.key != key) {
+        std::cerr << "Ignoring stale " << what << ": " << path << std::endl;
+        return false;
+    }
+
+    payload.assign(data.begin() + sizeof(header), data.end());
+    return true;
+}
+
+bool CacheFile::WriteAtomically(const std::string& path, uint32_t magic, uint32_t version, uint64_t key,
+                                const char* what, const std::vector<std::pair<const void*, size_t>>& chunks) {
+    std::error_code error;
+    std::filesystem::create_directories(CACHE_DIRECTORY, error);
+    if (error) {
+        std::cerr << "Failed to create " << CACHE_DIRECTORY << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    FileHeader header;
+    header.magic = magic;
+    header.version = version;
+    header.key = key;
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write " << what << ": " << path << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& chunk : chunks) {
+            file.write(static_cast<const char*>(chunk.first), chunk.second);
+        }
+        if (!file) {
+            file.close();
+            std::filesystem::remove(tempPath, error);
+            std::cerr << "Failed to write " << what << ": " << path << std::endl;
+            return false;
+        }
+    }
+
+    // Unlike std::rename, this replaces an existing file on Windows too
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        std::cerr << "Failed to write " << what << ": " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,280 @@
+#include "rendering/CellGridRenderer.h"
+#include "rendering/TextRenderer.h"
+#include <iostream>
+#include <algorithm>
+#include "rendering/GLState.h"
+
+// Full-screen triangle, no vertex buffer needed
+const char* cellGridVertexShader = R"(
+#version 330 core
+void main()
+{
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* cellGridFragmentShader = R"(
+#version 330 core
+out vec4 color;
+
+uniform usampler2D cells;          // <glyph slot, foreground, background, attributes> per cell
+uniform sampler2D atlas;
+uniform samplerBuffer glyphTable;  // 2 texels per glyph: uv rect, <size, bearing>
+uniform sampler2D palette;         // 256 x 1 colors
+uniform vec2 origin;               // Left edge and top of the grid
+uniform vec2 cellSize;             // <advance, line height>
+uniform ivec2 gridSize;            // <columns, ring rows>
+uniform int firstRow;              // Ring row shown at the top of the screen
+uniform int rowCount;              // Rows in use, from the top
+uniform float sdfSpread;           // 0 for coverage bitmaps
+uniform vec2 fragmentScale;        // Screen pixels per render target pixel
+
+const uint BOLD = 1u;
+const uint DIM = 2u;
+const uint INVERSE = 4u;
+
+uvec4 fetchCell(int col, int row)
+{
+    if (row < 0 || row >= rowCount) {
+        return uvec4(0u);
+    }
+    return texelFetch(cells, ivec2(col, (firstRow + row) % gridSize.y), 0);
+}
+
+// Foreground and background of a cell, with inverse and dim applied
+void cellColors(uvec4 cell, out vec3 foreground, out vec3 background)
+{
+    foreground = texelFetch(palette, ivec2(int(cell.g), 0), 0).rgb;
+    background = texelFetch(palette, ivec2(int(cell.b), 0), 0).rgb;
+    if ((cell.a & INVERSE) != 0u) {
+        vec3 swap = foreground;
+        foreground = background;
+        background = swap;
+    }
+    if ((cell.a & DIM) != 0u) {
+        foreground *= 0.6;
+    }
+}
+
+// Coverage of the glyph in screen row `row` at fragment position p
+float glyphCoverage(int col, int row, vec2 p, uvec4 cell)
+{
+    int slot = int(cell.r) * 2;
+    vec4 uvRect = texelFetch(glyphTable, slot);
+    vec4 metrics = texelFetch(glyphTable, slot + 1);
+    if (metrics.x <= 0.0 || metrics.y <= 0.0) {
+        return 0.0;
+    }
+
+    // Same placement as the instanced path: baseline at the bottom of the row
+    vec2 pen = vec2(origin.x + float(col) * cellSize.x, origin.y - float(row + 1) * cellSize.y);
+    vec2 boxMin = pen + vec2(metrics.z, metrics.w - metrics.y);
+    vec2 local = (p - boxMin) / metrics.xy;
+    if (any(lessThan(local, vec2(0.0))) || any(greaterThanEqual(local, vec2(1.0)))) {
+        return 0.0;
+    }
+
+    vec2 uv = vec2(mix(uvRect.x, uvRect.z, local.x), mix(uvRect.w, uvRect.y, local.y));
+    float coverage = texture(atlas, uv).r;
+    bool bold = (cell.a & BOLD) != 0u;
+    if (sdfSpread > 0.0) {
+        // Cells are drawn at scale 1, so atlas and screen pixels match
+        float distance = (coverage - 0.5) * 2.0 * sdfSpread + (bold ? 0.5 : 0.0);
+        coverage = clamp(distance + 0.5, 0.0, 1.0);
+    } else if (bold) {
+        coverage = min(coverage * 2.0, 1.0);
+    }
+    return coverage;
+}
+
+void main()
+{
+    vec2 p = gl_FragCoord.xy * fragmentScale;
+    int col = int(floor((p.x - origin.x) / cellSize.x));
+    int row = int(floor((origin.y - p.y) / cellSize.y));
+    if (col < 0 || col >= gridSize.x || row < 0 || row >= rowCount) {
+        discard;
+    }
+
+    vec3 foreground, background, foregroundAbove, backgroundAbove;
+    uvec4 cell = fetchCell(col, row);
+    uvec4 cellAbove = fetchCell(col, row - 1);
+    cellColors(cell, foreground, background);
+    cellColors(cellAbove, foregroundAbove, backgroundAbove);
+
+    // Descenders of the row above reach down into this one
+    float alpha = glyphCoverage(col, row, p, cell);
+    float above = row > 0 ? glyphCoverage(col, row - 1, p, cellAbove) : 0.0;
+    if (above > alpha) {
+        alpha = above;
+        foreground = foregroundAbove;
+    }
+
+    bool filled = cell.b != 0u || (cell.a & INVERSE) != 0u;
+    if (filled) {
+        color = vec4(mix(background, foreground, alpha), 1.0);
+    } else if (alpha > 0.0) {
+        color = vec4(foreground, alpha);
+    } else {
+        discard;
+    }
+}
+)";
+
+CellGridRenderer::CellGridRenderer()
+    : m_CellTexture(0), m_VAO(0),
+      m_OriginLocation(-1), m_CellSizeLocation(-1), m_GridSizeLocation(-1),
+      m_FirstRowLocation(-1), m_RowCountLocation(-1), m_SDFSpreadLocation(-1),
+      m_FragmentScaleLocation(-1),
+      m_Columns(0), m_Rows(0) {
+}
+
+CellGridRenderer::~CellGridRenderer() {
+    if (m_CellTexture) GLState::DeleteTexture(m_CellTexture);
+    if (m_VAO) GLState::DeleteVertexArray(m_VAO);
+}
+
+bool CellGridRenderer::Initialize() {
+    if (!CreateShader()) {
+        return false;
+    }
+
+    // Core profile needs a VAO bound even though there are no attributes
+    glGenVertexArrays(1, &m_VAO);
+
+    std::cout << "Cell grid renderer initialized successfully" << std::endl;
+    return true;
+}
+
+bool CellGridRenderer::CreateShader() {
+    if (!m_Shader.Create("Cell grid", cellGridVertexShader, cellGridFragmentShader)) {
+        return false;
+    }
+    m_OriginLocation = m_Shader.GetUniformLocation("origin");
+    m_CellSizeLocation = m_Shader.GetUniformLocation("cellSize");
+    m_GridSizeLocation = m_Shader.GetUniformLocation("gridSize");
+    m_FirstRowLocation = m_Shader.GetUniformLocation("firstRow");
+    m_RowCountLocation = m_Shader.GetUniformLocation("rowCount");
+    m_SDFSpreadLocation = m_Shader.GetUniformLocation("sdfSpread");
+    m_FragmentScaleLocation = m_Shader.GetUniformLocation("fragmentScale");
+
+    m_Shader.Use();
+    glUniform1i(m_Shader.GetUniformLocation("atlas"), ATLAS_UNIT);
+    glUniform1i(m_Shader.GetUniformLocation("glyphTable"), GLYPH_TABLE_UNIT);
+    glUniform1i(m_Shader.GetUniformLocation("cells"), CELL_UNIT);
+    glUniform1i(m_Shader.GetUniformLocation("palette"), PALETTE_UNIT);
+
+    return true;
+}
+
+void CellGridRenderer::Resize(unsigned int columns, unsigned int rows) {
+    if (columns == m_Columns && rows == m_Rows && m_CellTexture) {
+        return;
+    }
+
+    m_Columns = columns;
+    m_Rows = rows;
+    m_RowStates.assign(rows, RowState{UINT64_MAX, std::string(), {}, 0, 0});
+    m_RowScratch.assign(columns * 4, 0);
+
+    if (!m_CellTexture) {
+        glGenTextures(1, &m_CellTexture);
+    }
+    std::vector<uint16_t> empty(columns * rows * 4, 0);
+    GLState::BindTexture(CELL_UNIT, GL_TEXTURE_2D, m_CellTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, columns, rows, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, empty.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void CellGridRenderer::SetRow(uint64_t seq, const std::string& text, const std::vector<StyleRun>& styles,
+                              TextRenderer* renderer) {
+    if (m_Rows == 0) {
+        return;
+    }
+
+    unsigned int textureRow = static_cast<unsigned int>(seq % m_Rows);
+    RowState& state = m_RowStates[textureRow];
+    if (state.seq == seq && state.glyphGeneration == renderer->GetGlyphGeneration() &&
+        state.text == text && SameStyles(state.styles, styles)) {
+        renderer->TouchGlyphPages(state.glyphPages);
+        return;
+    }
+
+    state.seq = seq;
+    state.text = text;
+    state.styles = styles;
+
+    // Characters past the last column are clipped, like the instanced path
+    // drawing them off screen
+    std::fill(m_RowScratch.begin(), m_RowScratch.end(), 0);
+    static const TextStyle defaultStyle;
+    uint32_t pages = 0;
+    size_t index = 0, run = 0;
+    for (unsigned int column = 0; column < m_Columns && index < text.size(); ++column) {
+        while (run < styles.size() && styles[run].start <= index) {
+            ++run;
+        }
+        const TextStyle& style = run > 0 ? styles[run - 1].style : defaultStyle;
+
+        unsigned int slot = renderer->GetGlyphIndex(TextRenderer::NextCodepoint(text, index));
+        pages |= renderer->TouchGlyph(slot);
+        m_RowScratch[column * 4] = static_cast<uint16_t>(slot);
+        m_RowScratch[column * 4 + 1] = style.foreground;
+        m_RowScratch[column * 4 + 2] = style.background;
+        m_RowScratch[column * 4 + 3] = style.attributes;
+    }
+
+    // Loading glyphs may itself evict, but never pages touched this frame
+    state.glyphGeneration = renderer->GetGlyphGeneration();
+    state.glyphPages = pages;
+
+    GLState::BindTexture(CELL_UNIT, GL_TEXTURE_2D, m_CellTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, textureRow, m_Columns, 1,
+                    GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, m_RowScratch.data());
+}
+
+bool CellGridRenderer::SameStyles(const std::vector<StyleRun>& a, const std::vector<StyleRun>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].start != b[i].start || a[i].style != b[i].style) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CellGridRenderer::Draw(TextRenderer* renderer, glm::vec2 origin, float lineHeight,
+                            uint64_t firstSeq, unsigned int rowCount) {
+    if (!m_CellTexture || rowCount == 0) {
+        return;
+    }
+
+    // Rows set this frame may have rasterized new glyphs
+    renderer->CommitGlyphs();
+
+    m_Shader.Use();
+    glUniform2f(m_OriginLocation, origin.x, origin.y);
+    glUniform2f(m_CellSizeLocation, static_cast<float>(renderer->GetCharWidth('M')), lineHeight);
+    glUniform2i(m_GridSizeLocation, m_Columns, m_Rows);
+    glUniform1i(m_FirstRowLocation, static_cast<int>(firstSeq % m_Rows));
+    glUniform1i(m_RowCountLocation, std::min(rowCount, m_Rows));
+    glUniform1f(m_SDFSpreadLocation, renderer->GetSDFSpread());
+
+    // The CRT pass may render the scene below window resolution
+    glm::vec2 screenSize = renderer->GetScreenSize();
+    glm::vec2 viewportSize = renderer->GetViewportSize();
+    glUniform2f(m_FragmentScaleLocation, screenSize.x / std::max(viewportSize.x, 1.0f),
+                screenSize.y / std::max(viewportSize.y, 1.0f));
+
+    GLState::BindTexture(PALETTE_UNIT, GL_TEXTURE_2D, renderer->GetPaletteTexture());
+    GLState::BindTexture(CELL_UNIT, GL_TEXTURE_2D, m_CellTexture);
+    GLState::BindTexture(GLYPH_TABLE_UNIT, GL_TEXTURE_BUFFER, renderer->GetGlyphTableTexture());
+    GLState::BindTexture(ATLAS_UNIT, GL_TEXTURE_2D, renderer->GetAtlasTexture());
+
+    GLState::BindVertexArray(m_VAO);
+    GLState::DrawArrays(GL_TRIANGLES, 0, 3);
+}
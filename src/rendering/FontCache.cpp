@@ -0,0 +1,120 @@
+#include "rendering/FontCache.h"
+#include "rendering/CacheFile.h"
+#include <iostream>
+#include <cstring>
+
+static const uint32_t CACHE_MAGIC = 0x43544E46;  // "FNTC"
+static const uint32_t CACHE_VERSION = 1;
+
+// Follows the CacheFile header, then the records, then the pixel blob
+struct FontHeader {
+    uint32_t glyphCount;
+    uint32_t pixelBytes;
+};
+
+struct CacheRecord {
+    uint32_t codepoint;
+    int16_t width, height;
+    int16_t bearingX, bearingY;
+    uint32_t advance;
+    uint32_t pixelOffset;
+};
+
+uint64_t FontCache::MakeKey(const std::vector<unsigned char>& fontData, unsigned int pixelSize,
+                            uint32_t firstCodepoint, uint32_t lastCodepoint, uint32_t sdfSpread) {
+    uint64_t hash = CacheFile::HASH_SEED;
+    hash = CacheFile::Hash(hash, fontData.data(), fontData.size());
+    hash = CacheFile::Hash(hash, &pixelSize, sizeof(pixelSize));
+    hash = CacheFile::Hash(hash, &firstCodepoint, sizeof(firstCodepoint));
+    hash = CacheFile::Hash(hash, &lastCodepoint, sizeof(lastCodepoint));
+    hash = CacheFile::Hash(hash, &sdfSpread, sizeof(sdfSpread));
+    return hash;
+}
+
+std::string FontCache::GetPath(uint64_t key) {
+    return CacheFile::GetPath("font", key);
+}
+
+bool FontCache::Load(const std::string& path, uint64_t key) {
+    std::vector<char> data;
+    if (!CacheFile::Read(path, CACHE_MAGIC, CACHE_VERSION, key, "font cache", data)) {
+        return false;
+    }
+
+    FontHeader header;
+    if (data.size() < sizeof(header)) {
+        std::cerr << "Ignoring corrupt font cache: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    size_t recordBytes = sizeof(CacheRecord) * header.glyphCount;
+    if (data.size() != sizeof(header) + recordBytes + header.pixelBytes) {
+        std::cerr << "Ignoring corrupt font cache: " << path << std::endl;
+        return false;
+    }
+
+    const char* records = data.data() + sizeof(header);
+    m_Pixels.assign(records + recordBytes, records + recordBytes + header.pixelBytes);
+    m_Glyphs.clear();
+    m_Glyphs.reserve(header.glyphCount);
+    for (uint32_t i = 0; i < header.glyphCount; ++i) {
+        CacheRecord record;
+        std::memcpy(&record, records + i * sizeof(record), sizeof(record));
+        if (record.width < 0 || record.height < 0 ||
+            record.pixelOffset + static_cast<size_t>(record.width) * record.height > m_Pixels.size()) {
+            std::cerr << "Ignoring corrupt font cache: " << path << std::endl;
+            m_Glyphs.clear();
+            return false;
+        }
+
+        Glyph glyph;
+        glyph.codepoint = record.codepoint;
+        glyph.character = Character();
+        glyph.character.Size = glm::ivec2(record.width, record.height);
+        glyph.character.Bearing = glm::ivec2(record.bearingX, record.bearingY);
+        glyph.character.Advance = record.advance;
+        glyph.pixelOffset = record.pixelOffset;
+        m_Glyphs.push_back(glyph);
+    }
+
+    return true;
+}
+
+bool FontCache::Save(const std::string& path, uint64_t key) const {
+    FontHeader header;
+    header.glyphCount = static_cast<uint32_t>(m_Glyphs.size());
+    header.pixelBytes = static_cast<uint32_t>(m_Pixels.size());
+
+    std::vector<CacheRecord> records;
+    records.reserve(m_Glyphs.size());
+    for (const Glyph& glyph : m_Glyphs) {
+        CacheRecord record;
+        record.codepoint = glyph.codepoint;
+        record.width = static_cast<int16_t>(glyph.character.Size.x);
+        record.height = static_cast<int16_t>(glyph.character.Size.y);
+        record.bearingX = static_cast<int16_t>(glyph.character.Bearing.x);
+        record.bearingY = static_cast<int16_t>(glyph.character.Bearing.y);
+        record.advance = glyph.character.Advance;
+        record.pixelOffset = static_cast<uint32_t>(glyph.pixelOffset);
+        records.push_back(record);
+    }
+
+    return CacheFile::WriteAtomically(path, CACHE_MAGIC, CACHE_VERSION, key, "font cache", {
+        {&header, sizeof(header)},
+        {records.data(), sizeof(CacheRecord) * records.size()},
+        {m_Pixels.data(), m_Pixels.size()}
+    });
+}
+
+void FontCache::AddGlyph(uint32_t codepoint, const Character& character, const unsigned char* pixels, int pitch) {
+    Glyph glyph;
+    glyph.codepoint = codepoint;
+    glyph.character = character;
+    glyph.pixelOffset = m_Pixels.size();
+
+    // Stored tightly packed, whatever FreeType's row pitch was
+    for (int row = 0; row < character.Size.y; ++row) {
+        m_Pixels.insert(m_Pixels.end(), pixels + row * pitch, pixels + row * pitch + character.Size.x);
+    }
+    m_Glyphs.push_back(glyph);
+}
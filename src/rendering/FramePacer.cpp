@@ -0,0 +1,87 @@
+#include "rendering/FramePacer.h"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <limits>
+
+// Upper bucket limits in milliseconds: about a 240, 120, 60 and 30 Hz
+// frame, then multiples of a 60 Hz one
+static const double BUCKET_LIMITS[FramePacer::BUCKET_COUNT] = {
+    4.0, 8.0, 16.7, 33.3, 50.0, 66.7, 100.0, std::numeric_limits<double>::infinity()
+};
+
+// A fence that hasn't signalled after this long won't; give up on it
+static const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+FramePacer::FramePacer()
+    : m_SwapInterval(1), m_MaxFramesInFlight(0),
+      m_Buckets(), m_SampleCount(0), m_LatencySum(0.0), m_MaxLatency(0.0) {
+}
+
+FramePacer::~FramePacer() {
+    // Runs after glfwTerminate; the fences went with Engine::Shutdown
+}
+
+void FramePacer::SetSwapInterval(int interval) {
+    m_SwapInterval = std::max(0, std::min(interval, 2));
+    glfwSwapInterval(m_SwapInterval);
+}
+
+void FramePacer::SetMaxFramesInFlight(unsigned int frames) {
+    m_MaxFramesInFlight = std::min(frames, MAX_FRAMES_IN_FLIGHT);
+    if (m_MaxFramesInFlight == 0) {
+        ReleaseFences();
+    }
+}
+
+void FramePacer::WaitForFrameSlot() {
+    if (m_MaxFramesInFlight == 0) {
+        return;
+    }
+    while (m_Fences.size() >= m_MaxFramesInFlight) {
+        glClientWaitSync(m_Fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        glDeleteSync(m_Fences.front());
+        m_Fences.pop_front();
+    }
+}
+
+void FramePacer::OnSwap(double now) {
+    if (m_MaxFramesInFlight > 0) {
+        m_Fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    }
+
+    // Every key handled before this frame's render is on screen with it
+    for (double time : m_PendingInput) {
+        double milliseconds = (now - time) * 1000.0;
+        unsigned int bucket = 0;
+        while (milliseconds >= BUCKET_LIMITS[bucket]) {
+            ++bucket;
+        }
+        ++m_Buckets[bucket];
+        ++m_SampleCount;
+        m_LatencySum += milliseconds;
+        m_MaxLatency = std::max(m_MaxLatency, milliseconds);
+    }
+    m_PendingInput.clear();
+}
+
+void FramePacer::OnInput(double time) {
+    m_PendingInput.push_back(time);
+}
+
+double FramePacer::GetBucketLimit(unsigned int bucket) {
+    return BUCKET_LIMITS[bucket];
+}
+
+void FramePacer::ResetHistogram() {
+    std::fill(m_Buckets, m_Buckets + BUCKET_COUNT, 0u);
+    m_SampleCount = 0;
+    m_LatencySum = 0.0;
+    m_MaxLatency = 0.0;
+}
+
+void FramePacer::ReleaseFences() {
+    while (!m_Fences.empty()) {
+        glDeleteSync(m_Fences.front());
+        m_Fences.pop_front();
+    }
+}
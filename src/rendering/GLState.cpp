@@ -0,0 +1,141 @@
+#include "rendering/GLState.h"
+
+// Matches the GL defaults: nothing bound, unit 0 active
+unsigned int GLState::s_Program = 0;
+unsigned int GLState::s_VertexArray = 0;
+unsigned int GLState::s_ActiveUnit = 0;
+unsigned int GLState::s_Textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS] = {};
+unsigned int GLState::s_Buffers[BUFFER_TARGETS] = {};
+
+GLState::Counters GLState::s_Frame = {};
+GLState::Counters GLState::s_LastFrame = {};
+
+int GLState::TextureTargetIndex(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_BUFFER: return 1;
+        default: return -1;
+    }
+}
+
+int GLState::BufferTargetIndex(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_TEXTURE_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        default: return -1;
+    }
+}
+
+void GLState::UseProgram(unsigned int program) {
+    if (program == s_Program) {
+        ++s_Frame.skippedCalls;
+        return;
+    }
+    glUseProgram(program);
+    s_Program = program;
+    ++s_Frame.stateCalls;
+}
+
+void GLState::BindVertexArray(unsigned int vertexArray) {
+    if (vertexArray == s_VertexArray) {
+        ++s_Frame.skippedCalls;
+        return;
+    }
+    glBindVertexArray(vertexArray);
+    s_VertexArray = vertexArray;
+    ++s_Frame.stateCalls;
+}
+
+void GLState::BindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+    int index = TextureTargetIndex(target);
+    if (index >= 0 && unit < MAX_TEXTURE_UNITS && s_Textures[unit][index] == texture) {
+        ++s_Frame.skippedCalls;
+        return;
+    }
+
+    if (unit != s_ActiveUnit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        s_ActiveUnit = unit;
+        ++s_Frame.stateCalls;
+    }
+    glBindTexture(target, texture);
+    if (index >= 0 && unit < MAX_TEXTURE_UNITS) {
+        s_Textures[unit][index] = texture;
+    }
+    ++s_Frame.stateCalls;
+}
+
+void GLState::BindBuffer(GLenum target, unsigned int buffer) {
+    int index = BufferTargetIndex(target);
+    if (index >= 0 && s_Buffers[index] == buffer) {
+        ++s_Frame.skippedCalls;
+        return;
+    }
+    glBindBuffer(target, buffer);
+    if (index >= 0) {
+        s_Buffers[index] = buffer;
+    }
+    ++s_Frame.stateCalls;
+}
+
+void GLState::BindBufferBase(GLenum target, unsigned int index, unsigned int buffer) {
+    // Indexed bindings are set up once, so they aren't shadowed themselves
+    glBindBufferBase(target, index, buffer);
+    int targetIndex = BufferTargetIndex(target);
+    if (targetIndex >= 0) {
+        s_Buffers[targetIndex] = buffer;
+    }
+    ++s_Frame.stateCalls;
+}
+
+void GLState::DrawArrays(GLenum mode, int first, int count) {
+    glDrawArrays(mode, first, count);
+    ++s_Frame.drawCalls;
+}
+
+void GLState::DrawArraysInstanced(GLenum mode, int first, int count, int instanceCount) {
+    glDrawArraysInstanced(mode, first, count, instanceCount);
+    ++s_Frame.drawCalls;
+}
+
+void GLState::DeleteProgram(unsigned int program) {
+    glDeleteProgram(program);
+    // A program in use is only flagged for deletion, but forgetting it is
+    // harmless: the next UseProgram simply isn't skipped
+    if (s_Program == program) {
+        s_Program = 0;
+    }
+}
+
+void GLState::DeleteVertexArray(unsigned int vertexArray) {
+    glDeleteVertexArrays(1, &vertexArray);
+    if (s_VertexArray == vertexArray) {
+        s_VertexArray = 0;
+    }
+}
+
+void GLState::DeleteTexture(unsigned int texture) {
+    glDeleteTextures(1, &texture);
+    for (auto& unit : s_Textures) {
+        for (unsigned int& bound : unit) {
+            if (bound == texture) {
+                bound = 0;
+            }
+        }
+    }
+}
+
+void GLState::DeleteBuffer(unsigned int buffer) {
+    glDeleteBuffers(1, &buffer);
+    for (unsigned int& bound : s_Buffers) {
+        if (bound == buffer) {
+            bound = 0;
+        }
+    }
+}
+
+void GLState::BeginFrame() {
+    s_LastFrame = s_Frame;
+    s_Frame = Counters();
+}
@@ -0,0 +1,52 @@
+#include "rendering/GPUTimer.h"
+
+GPUTimer::GPUTimer() : m_Queries(), m_Next(0), m_Pending(0), m_Running(false) {
+}
+
+GPUTimer::~GPUTimer() {
+    if (m_Queries[0]) glDeleteQueries(QUERY_COUNT, m_Queries);
+}
+
+bool GPUTimer::Initialize() {
+    glGenQueries(QUERY_COUNT, m_Queries);
+    return m_Queries[0] != 0;
+}
+
+void GPUTimer::Begin() {
+    if (m_Running || m_Pending == QUERY_COUNT || !m_Queries[0]) {
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Next]);
+    m_Running = true;
+}
+
+void GPUTimer::End() {
+    if (!m_Running) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    m_Running = false;
+    m_Next = (m_Next + 1) % QUERY_COUNT;
+    ++m_Pending;
+}
+
+bool GPUTimer::Poll(double& milliseconds) {
+    bool found = false;
+
+    // Results arrive in issue order, so stop at the first one not ready
+    while (m_Pending > 0) {
+        unsigned int oldest = (m_Next + QUERY_COUNT - m_Pending) % QUERY_COUNT;
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(m_Queries[oldest], GL_QUERY_RESULT, &nanoseconds);
+        milliseconds = nanoseconds / 1.0e6;
+        found = true;
+        --m_Pending;
+    }
+    return found;
+}
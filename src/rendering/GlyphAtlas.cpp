@@ -0,0 +1,299 @@
+#include "rendering/GlyphAtlas.h"
+#include "rendering/GLState.h"
+#include <iostream>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+GlyphAtlas::GlyphAtlas()
+    : m_Texture(0), m_TableBuffer(0), m_TableTexture(0),
+      m_Width(0), m_Height(0), m_PageHeight(0),
+      m_DirtyMin(INT_MAX), m_DirtyMax(0),
+      m_DirtySlotMin(UINT_MAX), m_DirtySlotMax(0),
+      m_Frame(0), m_CommittedFrame(UINT64_MAX), m_Generation(0) {
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    if (m_Texture) GLState::DeleteTexture(m_Texture);
+    if (m_TableTexture) GLState::DeleteTexture(m_TableTexture);
+    if (m_TableBuffer) GLState::DeleteBuffer(m_TableBuffer);
+}
+
+bool GlyphAtlas::Initialize(unsigned int width, unsigned int height, unsigned int pageCount, unsigned int maxGlyphs) {
+    if (pageCount == 0 || pageCount > MAX_PAGES || height % pageCount != 0 || maxGlyphs > 65536) {
+        std::cerr << "ERROR: Invalid glyph atlas layout" << std::endl;
+        return false;
+    }
+
+    m_Width = width;
+    m_Height = height;
+    m_PageHeight = height / pageCount;
+
+    m_Pixels.assign(m_Width * m_Height, 0);
+    m_Table.assign(maxGlyphs * 2, glm::vec4(0.0f));
+    m_SlotPages.assign(maxGlyphs, NO_PAGE);
+
+    m_Pages.resize(pageCount);
+    for (Page& page : m_Pages) {
+        page.skyline.assign(1, glm::ivec3(0, 0, m_Width));
+        page.lastUsed = 0;
+        page.pinned = false;
+    }
+
+    // Slot 0 is reserved as the empty glyph. Hand out low slots first.
+    m_FreeSlots.clear();
+    for (unsigned int slot = maxGlyphs - 1; slot > 0; --slot) {
+        m_FreeSlots.push_back(slot);
+    }
+
+    // Start from a cleared texture so padding around glyphs samples as empty
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
+    glGenTextures(1, &m_Texture);
+    GLState::BindTexture(TEXTURE_UNIT, GL_TEXTURE_2D, m_Texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_Width, m_Height, 0, GL_RED, GL_UNSIGNED_BYTE, m_Pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glGenBuffers(1, &m_TableBuffer);
+    GLState::BindBuffer(GL_TEXTURE_BUFFER, m_TableBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * m_Table.size(), m_Table.data(), GL_DYNAMIC_DRAW);
+
+    glGenTextures(1, &m_TableTexture);
+    GLState::BindTexture(TABLE_UNIT, GL_TEXTURE_BUFFER, m_TableTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_TableBuffer);
+
+    return true;
+}
+
+bool GlyphAtlas::AddGlyph(uint32_t codepoint, const unsigned char* pixels, int pitch,
+                          Character& character, std::vector<uint32_t>& evicted) {
+    const glm::ivec2& size = character.Size;
+
+    // Whitespace has nothing to draw and shares the empty slot
+    if (size.x <= 0 || size.y <= 0) {
+        character.UVMin = character.UVMax = glm::vec2(0.0f);
+        character.Index = 0;
+        return true;
+    }
+
+    // Each glyph box carries one pixel of padding on its top and left edge,
+    // so linear filtering never bleeds a neighbour in
+    int boxWidth = size.x + 1;
+    int boxHeight = size.y + 1;
+    if (boxWidth > static_cast<int>(m_Width) || boxHeight > static_cast<int>(m_PageHeight)) {
+        return false;
+    }
+
+    if (m_FreeSlots.empty() && !EvictLeastRecentlyUsed(evicted)) {
+        return false;
+    }
+
+    glm::ivec2 position;
+    int pageIndex = FindSpace(boxWidth, boxHeight, position);
+    while (pageIndex < 0) {
+        if (!EvictLeastRecentlyUsed(evicted)) {
+            return false;
+        }
+        pageIndex = FindSpace(boxWidth, boxHeight, position);
+    }
+
+    int x = position.x + 1;
+    int y = pageIndex * static_cast<int>(m_PageHeight) + position.y + 1;
+    for (int row = 0; row < size.y; ++row) {
+        std::memcpy(&m_Pixels[(y + row) * m_Width + x], pixels + row * pitch, size.x);
+    }
+    MarkPixelsDirty(x - 1, y - 1, x + size.x, y + size.y);
+
+    unsigned int slot = m_FreeSlots.back();
+    m_FreeSlots.pop_back();
+
+    Page& page = m_Pages[pageIndex];
+    page.slots.push_back(slot);
+    page.codepoints.push_back(codepoint);
+    page.lastUsed = m_Frame;
+    m_SlotPages[slot] = static_cast<uint8_t>(pageIndex);
+
+    character.UVMin = glm::vec2(static_cast<float>(x) / m_Width, static_cast<float>(y) / m_Height);
+    character.UVMax = glm::vec2(static_cast<float>(x + size.x) / m_Width,
+                                static_cast<float>(y + size.y) / m_Height);
+    character.Index = slot;
+
+    m_Table[slot * 2] = glm::vec4(character.UVMin.x, character.UVMin.y, character.UVMax.x, character.UVMax.y);
+    m_Table[slot * 2 + 1] = glm::vec4(
+        static_cast<float>(size.x), static_cast<float>(size.y),
+        static_cast<float>(character.Bearing.x), static_cast<float>(character.Bearing.y));
+    MarkSlotDirty(slot);
+
+    return true;
+}
+
+void GlyphAtlas::PinAllocatedPages() {
+    for (Page& page : m_Pages) {
+        if (!page.slots.empty()) {
+            page.pinned = true;
+        }
+    }
+}
+
+void GlyphAtlas::TouchPages(uint32_t pageMask) {
+    for (size_t i = 0; i < m_Pages.size() && pageMask; ++i, pageMask >>= 1) {
+        if (pageMask & 1) {
+            m_Pages[i].lastUsed = m_Frame;
+        }
+    }
+}
+
+void GlyphAtlas::Commit() {
+    bool pixelsDirty = m_DirtyMin.x < m_DirtyMax.x && m_DirtyMin.y < m_DirtyMax.y;
+    bool tableDirty = m_DirtySlotMin <= m_DirtySlotMax;
+    if ((!pixelsDirty && !tableDirty) || m_CommittedFrame == m_Frame) {
+        return;
+    }
+    m_CommittedFrame = m_Frame;
+
+    if (pixelsDirty) {
+        // One sub-rectangle covering everything written since the last commit
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_Width);
+        GLState::BindTexture(TEXTURE_UNIT, GL_TEXTURE_2D, m_Texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, m_DirtyMin.x, m_DirtyMin.y,
+                        m_DirtyMax.x - m_DirtyMin.x, m_DirtyMax.y - m_DirtyMin.y,
+                        GL_RED, GL_UNSIGNED_BYTE, &m_Pixels[m_DirtyMin.y * m_Width + m_DirtyMin.x]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        m_DirtyMin = glm::ivec2(INT_MAX);
+        m_DirtyMax = glm::ivec2(0);
+    }
+
+    if (tableDirty) {
+        GLState::BindBuffer(GL_TEXTURE_BUFFER, m_TableBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER,
+                        sizeof(glm::vec4) * m_DirtySlotMin * 2,
+                        sizeof(glm::vec4) * (m_DirtySlotMax - m_DirtySlotMin + 1) * 2,
+                        &m_Table[m_DirtySlotMin * 2]);
+        m_DirtySlotMin = UINT_MAX;
+        m_DirtySlotMax = 0;
+    }
+}
+
+bool GlyphAtlas::Allocate(Page& page, int width, int height, glm::ivec2& position) {
+    // Bottom-left skyline: rest the box on each segment in turn and keep the
+    // placement that ends up highest on the page
+    std::vector<glm::ivec3>& skyline = page.skyline;
+    int bestY = INT_MAX;
+    size_t bestIndex = skyline.size();
+
+    for (size_t i = 0; i < skyline.size(); ++i) {
+        int x = skyline[i].x;
+        if (x + width > static_cast<int>(m_Width)) {
+            break;
+        }
+
+        int y = 0;
+        int remaining = width;
+        for (size_t j = i; remaining > 0; ++j) {
+            y = std::max(y, skyline[j].y);
+            remaining -= skyline[j].z;
+        }
+
+        if (y + height <= static_cast<int>(m_PageHeight) && y < bestY) {
+            bestY = y;
+            bestIndex = i;
+        }
+    }
+
+    if (bestIndex == skyline.size()) {
+        return false;
+    }
+
+    position = glm::ivec2(skyline[bestIndex].x, bestY);
+    glm::ivec3 segment(position.x, bestY + height, width);
+    skyline.insert(skyline.begin() + bestIndex, segment);
+
+    // Trim the segments the new one now covers
+    int end = segment.x + segment.z;
+    size_t i = bestIndex + 1;
+    while (i < skyline.size() && skyline[i].x < end) {
+        int overlap = end - skyline[i].x;
+        if (overlap >= skyline[i].z) {
+            skyline.erase(skyline.begin() + i);
+        } else {
+            skyline[i].x += overlap;
+            skyline[i].z -= overlap;
+            break;
+        }
+    }
+
+    // Merge neighbours at the same height
+    for (i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].z += skyline[i + 1].z;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+
+    return true;
+}
+
+int GlyphAtlas::FindSpace(int width, int height, glm::ivec2& position) {
+    for (size_t i = 0; i < m_Pages.size(); ++i) {
+        if (Allocate(m_Pages[i], width, height, position)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool GlyphAtlas::EvictLeastRecentlyUsed(std::vector<uint32_t>& evicted) {
+    size_t victim = m_Pages.size();
+    for (size_t i = 0; i < m_Pages.size(); ++i) {
+        const Page& page = m_Pages[i];
+        if (page.pinned || page.slots.empty() || page.lastUsed == m_Frame) {
+            continue;
+        }
+        if (victim == m_Pages.size() || page.lastUsed < m_Pages[victim].lastUsed) {
+            victim = i;
+        }
+    }
+
+    if (victim == m_Pages.size()) {
+        return false;
+    }
+
+    Page& page = m_Pages[victim];
+    for (unsigned int slot : page.slots) {
+        m_Table[slot * 2] = glm::vec4(0.0f);
+        m_Table[slot * 2 + 1] = glm::vec4(0.0f);
+        MarkSlotDirty(slot);
+        m_SlotPages[slot] = NO_PAGE;
+        m_FreeSlots.push_back(slot);
+    }
+    evicted.insert(evicted.end(), page.codepoints.begin(), page.codepoints.end());
+    page.slots.clear();
+    page.codepoints.clear();
+    page.skyline.assign(1, glm::ivec3(0, 0, m_Width));
+
+    // Clear the old pixels too, or they would bleed into the padding of
+    // whatever gets packed here next
+    int y0 = static_cast<int>(victim * m_PageHeight);
+    std::memset(&m_Pixels[y0 * m_Width], 0, m_PageHeight * m_Width);
+    MarkPixelsDirty(0, y0, m_Width, y0 + m_PageHeight);
+
+    ++m_Generation;
+    return true;
+}
+
+void GlyphAtlas::MarkPixelsDirty(int x0, int y0, int x1, int y1) {
+    m_DirtyMin.x = std::min(m_DirtyMin.x, std::max(x0, 0));
+    m_DirtyMin.y = std::min(m_DirtyMin.y, std::max(y0, 0));
+    m_DirtyMax.x = std::max(m_DirtyMax.x, x1);
+    m_DirtyMax.y = std::max(m_DirtyMax.y, y1);
+}
+
+void GlyphAtlas::MarkSlotDirty(unsigned int slot) {
+    m_DirtySlotMin = std::min(m_DirtySlotMin, slot);
+    m_DirtySlotMax = std::max(m_DirtySlotMax, slot);
+}
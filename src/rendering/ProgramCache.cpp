@@ -0,0 +1,107 @@
+#include "rendering/ProgramCache.h"
+#include "rendering/CacheFile.h"
+#include <glad/glad.h>
+#include <vector>
+#include <cstring>
+
+static const uint32_t CACHE_MAGIC = 0x47525043;  // "CPRG"
+static const uint32_t CACHE_VERSION = 1;
+
+// Follows the CacheFile header, then the binary itself
+struct ProgramHeader {
+    uint32_t binaryFormat;
+    uint32_t binaryLength;
+};
+
+// Strings are hashed with their terminator, so ("ab", "c") and ("a", "bc")
+// give different keys
+static uint64_t HashString(uint64_t hash, const char* text) {
+    if (!text) {
+        text = "";
+    }
+    return CacheFile::Hash(hash, text, std::strlen(text) + 1);
+}
+
+bool ProgramCache::IsSupported() {
+    static int supported = -1;
+    if (supported < 0) {
+        GLint formats = 0;
+        if (GLAD_GL_VERSION_4_1 && glProgramBinary && glGetProgramBinary) {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        }
+        supported = formats > 0 ? 1 : 0;
+    }
+    return supported == 1;
+}
+
+uint64_t ProgramCache::MakeKey(const char* vertexSource, const char* fragmentSource) {
+    // The driver identity is the same for every program, so hash it once
+    static uint64_t driverHash = 0;
+    if (driverHash == 0) {
+        driverHash = CacheFile::HASH_SEED;
+        driverHash = HashString(driverHash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+        driverHash = HashString(driverHash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+        driverHash = HashString(driverHash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    }
+
+    uint64_t hash = driverHash;
+    hash = HashString(hash, vertexSource);
+    hash = HashString(hash, fragmentSource);
+    return hash;
+}
+
+std::string ProgramCache::GetPath(uint64_t key) {
+    return CacheFile::GetPath("program", key);
+}
+
+bool ProgramCache::Load(uint64_t key, unsigned int program) {
+    if (!IsSupported()) {
+        return false;
+    }
+
+    std::vector<char> data;
+    if (!CacheFile::Read(GetPath(key), CACHE_MAGIC, CACHE_VERSION, key, "program cache", data)) {
+        return false;
+    }
+
+    ProgramHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (data.size() != sizeof(header) + header.binaryLength) {
+        return false;
+    }
+
+    // Drivers may refuse binaries after an update even with matching
+    // strings; that shows up as a failed link
+    glProgramBinary(program, header.binaryFormat, data.data() + sizeof(header), header.binaryLength);
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+}
+
+bool ProgramCache::Save(uint64_t key, unsigned int program) {
+    if (!IsSupported()) {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return false;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    ProgramHeader header;
+    header.binaryFormat = format;
+    header.binaryLength = static_cast<uint32_t>(length);
+
+    return CacheFile::WriteAtomically(GetPath(key), CACHE_MAGIC, CACHE_VERSION, key, "program cache", {
+        {&header, sizeof(header)},
+        {binary.data(), header.binaryLength}
+    });
+}
@@ -0,0 +1,81 @@
+#include "rendering/RenderTargetPool.h"
+#include "rendering/GLState.h"
+#include <iostream>
+
+// Targets are set up on unit 0; their users bind them wherever they sample
+static const unsigned int SETUP_UNIT = 0;
+
+RenderTargetPool::RenderTargetPool() {
+}
+
+RenderTargetPool::~RenderTargetPool() {
+    for (const auto& target : m_Targets) {
+        Destroy(*target);
+    }
+}
+
+RenderTarget* RenderTargetPool::Acquire(unsigned int width, unsigned int height, GLenum format) {
+    for (const auto& target : m_Targets) {
+        if (!target->inUse && target->width == width && target->height == height &&
+            target->format == format) {
+            target->inUse = true;
+            return target.get();
+        }
+    }
+
+    std::unique_ptr<RenderTarget> target = std::make_unique<RenderTarget>();
+    target->framebuffer = 0;
+    target->texture = 0;
+    target->width = width;
+    target->height = height;
+    target->format = format;
+    target->inUse = true;
+
+    // No data is uploaded, so the client format only has to be legal
+    glGenTextures(1, &target->texture);
+    GLState::BindTexture(SETUP_UNIT, GL_TEXTURE_2D, target->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!complete) {
+        std::cerr << "ERROR: Render target framebuffer is not complete!" << std::endl;
+        Destroy(*target);
+        return nullptr;
+    }
+
+    m_Targets.push_back(std::move(target));
+    return m_Targets.back().get();
+}
+
+void RenderTargetPool::Release(RenderTarget* target) {
+    if (target) {
+        target->inUse = false;
+    }
+}
+
+void RenderTargetPool::Trim() {
+    for (size_t i = 0; i < m_Targets.size();) {
+        if (m_Targets[i]->inUse) {
+            ++i;
+            continue;
+        }
+        Destroy(*m_Targets[i]);
+        m_Targets[i] = std::move(m_Targets.back());
+        m_Targets.pop_back();
+    }
+}
+
+void RenderTargetPool::Destroy(RenderTarget& target) {
+    if (target.framebuffer) glDeleteFramebuffers(1, &target.framebuffer);
+    if (target.texture) GLState::DeleteTexture(target.texture);
+    target.framebuffer = target.texture = 0;
+}
@@ -0,0 +1,120 @@
+#include "rendering/ShaderProgram.h"
+#include "rendering/GLState.h"
+#include "rendering/ProgramCache.h"
+#include <iostream>
+#include <vector>
+
+ShaderProgram::ShaderProgram() : m_Program(0) {
+}
+
+ShaderProgram::~ShaderProgram() {
+    if (m_Program) GLState::DeleteProgram(m_Program);
+}
+
+bool ShaderProgram::Create(const std::string& name, const char* vertexSource, const char* fragmentSource) {
+    m_Name = name;
+
+    // A cached binary skips compiling and linking entirely
+    uint64_t key = ProgramCache::MakeKey(vertexSource, fragmentSource);
+    m_Program = glCreateProgram();
+    if (ProgramCache::Load(key, m_Program)) {
+        ResolveUniforms();
+        return true;
+    }
+
+    unsigned int vertexShader = Compile(GL_VERTEX_SHADER, vertexSource);
+    if (!vertexShader) {
+        return false;
+    }
+    unsigned int fragmentShader = Compile(GL_FRAGMENT_SHADER, fragmentSource);
+    if (!fragmentShader) {
+        glDeleteShader(vertexShader);
+        return false;
+    }
+
+    if (ProgramCache::IsSupported()) {
+        glProgramParameteri(m_Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(m_Program, vertexShader);
+    glAttachShader(m_Program, fragmentShader);
+    glLinkProgram(m_Program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    int success;
+    glGetProgramiv(m_Program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(m_Program, 512, NULL, infoLog);
+        std::cerr << "ERROR: " << m_Name << " shader program linking failed\n" << infoLog << std::endl;
+        return false;
+    }
+
+    ProgramCache::Save(key, m_Program);
+    ResolveUniforms();
+    return true;
+}
+
+unsigned int ShaderProgram::Compile(GLenum type, const char* source) {
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "ERROR: " << m_Name << (type == GL_VERTEX_SHADER ? " vertex" : " fragment")
+                  << " shader compilation failed\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+void ShaderProgram::ResolveUniforms() {
+    m_Uniforms.clear();
+
+    int count = 0, maxLength = 0;
+    glGetProgramiv(m_Program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength > 0 ? maxLength : 1);
+
+    for (int i = 0; i < count; ++i) {
+        int length = 0, size = 0;
+        GLenum type;
+        glGetActiveUniform(m_Program, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+
+        // Uniform block members report location -1 and are skipped
+        std::string uniform(name.data(), length);
+        int location = glGetUniformLocation(m_Program, uniform.c_str());
+        if (location < 0) {
+            continue;
+        }
+
+        // Arrays are reported as "name[0]"; make "name" work too
+        if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) {
+            m_Uniforms[uniform.substr(0, uniform.size() - 3)] = location;
+        }
+        m_Uniforms[uniform] = location;
+    }
+}
+
+void ShaderProgram::Use() const {
+    GLState::UseProgram(m_Program);
+}
+
+bool ShaderProgram::BindUniformBlock(const std::string& block, unsigned int binding) {
+    unsigned int index = glGetUniformBlockIndex(m_Program, block.c_str());
+    if (index == GL_INVALID_INDEX) {
+        return false;
+    }
+    glUniformBlockBinding(m_Program, index, binding);
+    return true;
+}
+
+int ShaderProgram::GetUniformLocation(const std::string& uniform) const {
+    auto it = m_Uniforms.find(uniform);
+    return it != m_Uniforms.end() ? it->second : -1;
+}
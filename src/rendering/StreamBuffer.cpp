@@ -0,0 +1,175 @@
+#include "rendering/StreamBuffer.h"
+#include "rendering/GLState.h"
+#include <iostream>
+
+// Keep every allocation aligned so it can be used as an attribute offset
+static const size_t STREAM_ALIGNMENT = 16;
+
+StreamBuffer::StreamBuffer()
+    : m_Target(GL_ARRAY_BUFFER), m_Buffer(0), m_RegionSize(0),
+      m_RegionCount(0), m_Region(0), m_Cursor(0),
+      m_Persistent(false), m_PersistentPtr(nullptr), m_Mapped(nullptr) {
+}
+
+StreamBuffer::~StreamBuffer() {
+    DestroyStorage();
+}
+
+bool StreamBuffer::Initialize(GLenum target, size_t regionSize, unsigned int regionCount) {
+    m_Target = target;
+    m_RegionCount = regionCount;
+    m_Fences.assign(regionCount, nullptr);
+
+    if (!CreateStorage(regionSize)) {
+        return false;
+    }
+
+    std::cout << "Stream buffer: " << m_RegionCount << " x " << (m_RegionSize / 1024) << " KB, "
+              << (m_Persistent ? "persistent mapping" : "unsynchronized mapping") << std::endl;
+    return true;
+}
+
+bool StreamBuffer::CreateStorage(size_t regionSize) {
+    m_RegionSize = regionSize;
+    m_Region = 0;
+    m_Cursor = 0;
+
+    size_t totalSize = m_RegionSize * m_RegionCount;
+    glGenBuffers(1, &m_Buffer);
+    GLState::BindBuffer(m_Target, m_Buffer);
+
+    m_Persistent = GLAD_GL_VERSION_4_4 && glBufferStorage != nullptr;
+    if (m_Persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(m_Target, totalSize, NULL, flags);
+        m_PersistentPtr = static_cast<char*>(glMapBufferRange(m_Target, 0, totalSize, flags));
+        if (!m_PersistentPtr) {
+            std::cerr << "ERROR: Failed to persistently map stream buffer" << std::endl;
+            return false;
+        }
+    } else {
+        glBufferData(m_Target, totalSize, NULL, GL_STREAM_DRAW);
+    }
+
+    return true;
+}
+
+void StreamBuffer::DestroyStorage() {
+    for (GLsync& fence : m_Fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    if (m_Buffer) {
+        if (m_PersistentPtr || m_Mapped) {
+            GLState::BindBuffer(m_Target, m_Buffer);
+            glUnmapBuffer(m_Target);
+        }
+        GLState::DeleteBuffer(m_Buffer);
+        m_Buffer = 0;
+    }
+
+    m_PersistentPtr = nullptr;
+    m_Mapped = nullptr;
+}
+
+void StreamBuffer::BeginFrame() {
+    // Nothing written this frame means nothing to fence
+    if (m_Cursor > 0) {
+        NextRegion();
+    }
+}
+
+void* StreamBuffer::Map(size_t minSize, size_t& outCapacity) {
+    if (m_Mapped) {
+        std::cerr << "ERROR: Stream buffer mapped twice" << std::endl;
+        outCapacity = 0;
+        return nullptr;
+    }
+
+    // A single request bigger than a region: reallocate with larger regions.
+    // The driver keeps the old storage alive until in-flight draws finish.
+    if (minSize > m_RegionSize) {
+        size_t newSize = m_RegionSize;
+        while (newSize < minSize) {
+            newSize *= 2;
+        }
+        DestroyStorage();
+        if (!CreateStorage(newSize)) {
+            outCapacity = 0;
+            return nullptr;
+        }
+    }
+
+    if (m_Cursor + minSize > m_RegionSize) {
+        NextRegion();
+    }
+
+    size_t offset = m_Region * m_RegionSize + m_Cursor;
+    outCapacity = m_RegionSize - m_Cursor;
+
+    if (m_Persistent) {
+        m_Mapped = m_PersistentPtr + offset;
+    } else {
+        // The fences already guarantee the GPU is done with this range
+        GLState::BindBuffer(m_Target, m_Buffer);
+        m_Mapped = glMapBufferRange(m_Target, offset, outCapacity,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!m_Mapped) {
+            std::cerr << "ERROR: Failed to map stream buffer range" << std::endl;
+            outCapacity = 0;
+        }
+    }
+
+    return m_Mapped;
+}
+
+size_t StreamBuffer::Unmap(size_t used) {
+    size_t offset = m_Region * m_RegionSize + m_Cursor;
+
+    if (!m_Persistent && m_Mapped) {
+        GLState::BindBuffer(m_Target, m_Buffer);
+        glUnmapBuffer(m_Target);
+    }
+    m_Mapped = nullptr;
+
+    m_Cursor += (used + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+    if (m_Cursor > m_RegionSize) {
+        m_Cursor = m_RegionSize;
+    }
+    return offset;
+}
+
+void StreamBuffer::NextRegion() {
+    // Everything submitted so far reads from the current region
+    if (m_Fences[m_Region]) {
+        glDeleteSync(m_Fences[m_Region]);
+    }
+    m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    m_Region = (m_Region + 1) % m_RegionCount;
+    m_Cursor = 0;
+    WaitForRegion(m_Region);
+}
+
+void StreamBuffer::WaitForRegion(unsigned int region) {
+    GLsync fence = m_Fences[region];
+    if (!fence) {
+        return;
+    }
+
+    // Normally already signalled: the region was used frames ago
+    GLbitfield flags = 0;
+    while (true) {
+        GLenum result = glClientWaitSync(fence, flags, 1000000); // 1 ms
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+            break;
+        }
+        flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    }
+
+    glDeleteSync(fence);
+    m_Fences[region] = nullptr;
+}
@@ -0,0 +1,87 @@
+#include "rendering/TextMesh.h"
+#include "rendering/GLState.h"
+#include <algorithm>
+
+// Retired instances are compacted away once they make up half the buffer
+static const size_t MIN_COMPACT_INSTANCES = 1024;
+
+TextMesh::TextMesh()
+    : m_First(0), m_Uploaded(0), m_GlyphPages(0), m_Buffer(0), m_Capacity(0), m_Reupload(true) {
+}
+
+TextMesh::~TextMesh() {
+    if (m_Buffer) GLState::DeleteBuffer(m_Buffer);
+}
+
+void TextMesh::PushBack(const std::vector<GlyphInstance>& glyphs, glm::vec2 offset, uint32_t glyphPages) {
+    m_GlyphPages |= glyphPages;
+    m_Runs.push_back({glyphs.size(), glyphPages});
+    for (const GlyphInstance& glyph : glyphs) {
+        GlyphInstance instance = glyph;
+        instance.x += offset.x;
+        instance.y += offset.y;
+        m_Instances.push_back(instance);
+    }
+}
+
+void TextMesh::PopFront() {
+    if (m_Runs.empty()) {
+        return;
+    }
+    m_First += m_Runs.front().count;
+    m_Runs.pop_front();
+
+    // Pages only the retired run used no longer need to stay resident
+    m_GlyphPages = 0;
+    for (const Run& run : m_Runs) {
+        m_GlyphPages |= run.glyphPages;
+    }
+}
+
+void TextMesh::Clear() {
+    m_Instances.clear();
+    m_First = 0;
+    m_Uploaded = 0;
+    m_GlyphPages = 0;
+    m_Runs.clear();
+    m_Reupload = true;
+}
+
+size_t TextMesh::Sync() {
+    // Compact when retired instances dominate, so the buffer doesn't grow
+    // forever as lines scroll through it
+    if (m_First >= MIN_COMPACT_INSTANCES && m_First * 2 >= m_Instances.size()) {
+        m_Instances.erase(m_Instances.begin(), m_Instances.begin() + m_First);
+        m_First = 0;
+        m_Reupload = true;
+    }
+
+    if (!m_Buffer) {
+        glGenBuffers(1, &m_Buffer);
+        m_Reupload = true;
+    }
+
+    if (m_Instances.size() > m_Capacity) {
+        m_Capacity = std::max<size_t>(m_Capacity * 2, 4096);
+        while (m_Capacity < m_Instances.size()) {
+            m_Capacity *= 2;
+        }
+        m_Reupload = true;
+    }
+
+    GLState::BindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+    if (m_Reupload) {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GlyphInstance) * m_Capacity, NULL, GL_STATIC_DRAW);
+        m_Uploaded = 0;
+        m_Reupload = false;
+    }
+    if (m_Uploaded < m_Instances.size()) {
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        sizeof(GlyphInstance) * m_Uploaded,
+                        sizeof(GlyphInstance) * (m_Instances.size() - m_Uploaded),
+                        &m_Instances[m_Uploaded]);
+        m_Uploaded = m_Instances.size();
+    }
+
+    return sizeof(GlyphInstance) * m_First;
+}
@@ -1,19 +1,101 @@
 #include "rendering/TextRenderer.h"
+#include "rendering/TextMesh.h"
+#include "rendering/FontCache.h"
+#include "rendering/GLState.h"
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cstddef>
 #include <glm/gtc/matrix_transform.hpp>
+#include FT_MODULE_H
 
-// Vertex shader source
+// Number of 256 code point pages needed to cover all of Unicode
+static const size_t GLYPH_PAGE_COUNT = 0x110000 >> 8;
+
+// Glyph cache: a 1024x1024 atlas split into eight 128-pixel pages, and
+// table slots for 4096 glyphs
+static const unsigned int ATLAS_SIZE = 1024;
+static const unsigned int ATLAS_PAGES = 8;
+static const unsigned int MAX_GLYPHS = 4096;
+
+// SDF glyphs keep distances up to this many pixels either side of the edge.
+// FreeType's default of 2 leaves too little room for outlines and glow.
+static const int SDF_SPREAD = 4;
+
+// Drawn in place of malformed UTF-8
+static const uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+// Palette texture size, and how many slots QueueText colors can take
+static const size_t PALETTE_SIZE = 256;
+static const size_t MAX_PALETTE_COLORS = PALETTE_SIZE - PALETTE_DYNAMIC;
+
+static_assert(sizeof(GlyphInstance) == 16, "GlyphInstance must stay 16 bytes");
+
+// Vertex shader source. Each instance is one glyph, or one background cell;
+// the six vertices of its quad are generated from gl_VertexID and the
+// glyph table.
 const char* vertexShaderSource = R"(
 #version 330 core
-layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+layout (location = 0) in vec2 pen;         // Baseline pen position
+layout (location = 1) in uvec2 glyphScale; // <glyph slot, 8.8 scale>
+layout (location = 2) in uvec4 style;      // <foreground, attributes, background, cell width>
 out vec2 TexCoords;
+out vec3 TextColor;
+flat out float GlyphScale;
+flat out uint Attributes;
 
 uniform mat4 projection;
+uniform vec2 offset;               // Translation applied to the whole draw
+uniform samplerBuffer glyphTable;  // 2 texels per glyph: uv rect, <size, bearing>
+uniform sampler2D palette;         // 256 x 1 colors
+uniform vec2 cellMetrics;          // <line height, descent> of background cells
+
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 1.0), vec2(0.0, 0.0), vec2(1.0, 0.0),
+    vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0)
+);
+
+const uint BOLD = 1u;
+const uint DIM = 2u;
+const uint INVERSE = 4u;
+const uint CELL = 128u;
 
 void main()
 {
-    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
-    TexCoords = vertex.zw;
+    float scale = float(glyphScale.y) / 256.0;
+    vec2 corner = corners[gl_VertexID];
+
+    vec3 foreground = texelFetch(palette, ivec2(int(style.x), 0), 0).rgb;
+    vec3 background = texelFetch(palette, ivec2(int(style.z), 0), 0).rgb;
+    if ((style.y & INVERSE) != 0u) {
+        vec3 swap = foreground;
+        foreground = background;
+        background = swap;
+    }
+
+    if ((style.y & CELL) != 0u) {
+        // Solid quad spanning the advance and the line
+        vec2 origin = pen + offset - vec2(0.0, cellMetrics.y) * scale;
+        vec2 size = vec2(float(style.w), cellMetrics.x) * scale;
+        gl_Position = projection * vec4(origin + corner * size, 0.0, 1.0);
+        TexCoords = vec2(0.0);
+        TextColor = background;
+    } else {
+        int slot = int(glyphScale.x) * 2;
+        vec4 uvRect = texelFetch(glyphTable, slot);
+        vec4 metrics = texelFetch(glyphTable, slot + 1);
+
+        vec2 origin = pen + offset + vec2(metrics.z, metrics.w - metrics.y) * scale;
+        gl_Position = projection * vec4(origin + corner * metrics.xy * scale, 0.0, 1.0);
+
+        // Atlas rows run top-down, so the top of the quad samples uvRect.y
+        TexCoords = vec2(mix(uvRect.x, uvRect.z, corner.x), mix(uvRect.w, uvRect.y, corner.y));
+        TextColor = (style.y & DIM) != 0u ? foreground * 0.6 : foreground;
+    }
+    GlyphScale = scale;
+    Attributes = style.y;
 }
 )";
 
@@ -21,217 +103,640 @@ void main()
 const char* fragmentShaderSource = R"(
 #version 330 core
 in vec2 TexCoords;
+in vec3 TextColor;
+flat in float GlyphScale;
+flat in uint Attributes;
 out vec4 color;
 
 uniform sampler2D text;
-uniform vec3 textColor;
+uniform float sdfSpread;  // 0 for coverage bitmaps
 
 void main()
 {
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-    color = vec4(textColor, 1.0) * sampled;
+    if ((Attributes & 128u) != 0u) {
+        color = vec4(TextColor, 1.0);
+        return;
+    }
+
+    float alpha = texture(text, TexCoords).r;
+    bool bold = (Attributes & 1u) != 0u;
+    if (sdfSpread > 0.0) {
+        // Signed distance in screen pixels, then a one pixel wide edge.
+        // Bold pushes the edge half a pixel outwards.
+        float distance = (alpha - 0.5) * 2.0 * sdfSpread * GlyphScale;
+        if (bold) {
+            distance += 0.5 * GlyphScale;
+        }
+        alpha = clamp(distance + 0.5, 0.0, 1.0);
+    } else if (bold) {
+        alpha = min(alpha * 2.0, 1.0);
+    }
+    vec4 sampled = vec4(1.0, 1.0, 1.0, alpha);
+    color = vec4(TextColor, 1.0) * sampled;
 }
 )";
 
+// Default colors of the fixed palette slots: black background, amber text,
+// then the 16 ANSI colors
+static const glm::vec3 DEFAULT_PALETTE[PALETTE_DYNAMIC] = {
+    glm::vec3(0.0f, 0.0f, 0.0f),    glm::vec3(1.0f, 0.5f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 0.0f),    glm::vec3(0.8f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 0.8f, 0.0f),    glm::vec3(0.8f, 0.8f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 0.93f),   glm::vec3(0.8f, 0.0f, 0.8f),
+    glm::vec3(0.0f, 0.8f, 0.8f),    glm::vec3(0.9f, 0.9f, 0.9f),
+    glm::vec3(0.5f, 0.5f, 0.5f),    glm::vec3(1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f),    glm::vec3(1.0f, 1.0f, 0.0f),
+    glm::vec3(0.36f, 0.36f, 1.0f),  glm::vec3(1.0f, 0.0f, 1.0f),
+    glm::vec3(0.0f, 1.0f, 1.0f),    glm::vec3(1.0f, 1.0f, 1.0f)
+};
+
 TextRenderer::TextRenderer(unsigned int width, unsigned int height)
-    : m_VAO(0), m_VBO(0), m_ShaderProgram(0), m_FontHeight(0) {
+    : m_GlyphFormat(GlyphFormat::BITMAP), m_GlyphsDeferred(false), m_FreeType(nullptr), m_Face(nullptr),
+      m_VAO(0), m_Batch(nullptr), m_BatchCount(0), m_BatchCapacity(0),
+      m_PaletteData(PALETTE_SIZE * 4, 0), m_PaletteDirty(true), m_PaletteSRGB(false), m_PaletteTexture(0),
+      m_CellDescent(0.0f), m_ProjectionLocation(-1), m_OffsetLocation(-1),
+      m_CellMetricsLocation(-1), m_FontHeight(0) {
+    m_AsciiGlyphs.fill(Character());
+    m_FallbackGlyph = Character();
+    m_GlyphPages.resize(GLYPH_PAGE_COUNT);
+    for (uint8_t slot = 0; slot < PALETTE_DYNAMIC; ++slot) {
+        SetPaletteColor(slot, DEFAULT_PALETTE[slot]);
+    }
     UpdateProjection(width, height);
+    SetViewportSize(width, height);
 }
 
 TextRenderer::~TextRenderer() {
-    if (m_VAO) glDeleteVertexArrays(1, &m_VAO);
-    if (m_VBO) glDeleteBuffers(1, &m_VBO);
-    if (m_ShaderProgram) glDeleteProgram(m_ShaderProgram);
-    
-    // Clean up character textures
-    for (auto& pair : m_Characters) {
-        glDeleteTextures(1, &pair.second.TextureID);
-    }
+    if (m_VAO) GLState::DeleteVertexArray(m_VAO);
+    if (m_PaletteTexture) GLState::DeleteTexture(m_PaletteTexture);
+    if (m_Face) FT_Done_Face(m_Face);
+    if (m_FreeType) FT_Done_FreeType(m_FreeType);
 }
 
-bool TextRenderer::Initialize(const std::string& fontPath, unsigned int fontSize) {
+bool TextRenderer::Initialize(const std::string& fontPath, unsigned int fontSize, GlyphFormat format) {
+    m_GlyphFormat = format;
+
     // Create shaders
     if (!CreateShaders()) {
         return false;
     }
 
+    if (!m_Atlas.Initialize(ATLAS_SIZE, ATLAS_SIZE, ATLAS_PAGES, MAX_GLYPHS)) {
+        return false;
+    }
+
     // Load font
     if (!LoadFont(fontPath, fontSize)) {
         return false;
     }
 
-    // Configure VAO/VBO for texture quads
+    glGenTextures(1, &m_PaletteTexture);
+    GLState::BindTexture(PALETTE_UNIT, GL_TEXTURE_2D, m_PaletteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, PALETTE_SIZE, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_PaletteData.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    m_PaletteDirty = false;
+
+    // Instance data is streamed through a triple-buffered ring. Each region
+    // holds 64K glyphs, several full 4K screens; it grows if ever outrun.
+    if (!m_InstanceStream.Initialize(GL_ARRAY_BUFFER, sizeof(GlyphInstance) * 65536)) {
+        return false;
+    }
+
     glGenVertexArrays(1, &m_VAO);
-    glGenBuffers(1, &m_VBO);
-    glBindVertexArray(m_VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+    GLState::BindVertexArray(m_VAO);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    glVertexAttribDivisor(0, 1);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
 
     return true;
 }
 
 bool TextRenderer::LoadFont(const std::string& fontPath, unsigned int fontSize) {
-    FT_Library ft;
-    if (FT_Init_FreeType(&ft)) {
-        std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+    // Read the font once: it is hashed for the cache key, and FreeType opens
+    // it from memory if it is needed at all
+    std::ifstream file(fontPath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cerr << "ERROR::FREETYPE: Failed to load font: " << fontPath << std::endl;
         return false;
     }
-
-    FT_Face face;
-    if (FT_New_Face(ft, fontPath.c_str(), 0, &face)) {
+    m_FontData.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(m_FontData.data()), m_FontData.size())) {
         std::cerr << "ERROR::FREETYPE: Failed to load font: " << fontPath << std::endl;
-        FT_Done_FreeType(ft);
         return false;
     }
+    file.close();
 
-    FT_Set_Pixel_Sizes(face, 0, fontSize);
     m_FontHeight = fontSize;
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
+    // Only ASCII is loaded up front; everything else is rasterized the first
+    // time it is drawn. Code point 0 is skipped: glyph slot 0 is reserved as
+    // the empty glyph.
+    uint64_t cacheKey = FontCache::MakeKey(m_FontData, fontSize, 1, 127,
+                                           static_cast<uint32_t>(GetSDFSpread()));
+    std::string cachePath = FontCache::GetPath(cacheKey);
+    FontCache cache;
+    if (cache.Load(cachePath, cacheKey)) {
+        for (const FontCache::Glyph& glyph : cache.GetGlyphs()) {
+            Character character = glyph.character;
+            if (PlaceGlyph(glyph.codepoint, cache.GetPixels(glyph), character.Size.x, character)) {
+                SetCharacter(glyph.codepoint, character);
+            }
+        }
+    } else {
+        if (!OpenFace()) {
+            std::cerr << "ERROR::FREETYPE: Failed to load font: " << fontPath << std::endl;
+            return false;
+        }
+
+        for (uint32_t c = 1; c < 128; c++) {
+            Character character;
+            if (!LoadGlyph(c, character)) {
+                std::cerr << "ERROR::FREETYPE: Failed to load Glyph " << c << std::endl;
+                continue;
+            }
+            SetCharacter(c, character);
 
-    // Load first 128 ASCII characters
-    for (unsigned char c = 0; c < 128; c++) {
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-            std::cerr << "ERROR::FREETYPE: Failed to load Glyph " << c << std::endl;
-            continue;
+            const FT_Bitmap& bitmap = m_Face->glyph->bitmap;
+            cache.AddGlyph(c, character, bitmap.buffer, bitmap.pitch);
         }
+        cache.Save(cachePath, cacheKey);
+    }
+
+    // ASCII stays resident no matter what else gets loaded
+    m_Atlas.PinAllocatedPages();
+    m_Atlas.Commit();
+
+    if (m_AsciiLoaded.test('?')) {
+        m_FallbackGlyph = m_AsciiGlyphs['?'];
+    }
 
-        // Generate texture
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            static_cast<unsigned int>(face->glyph->advance.x)
-        };
-        m_Characters.insert(std::pair<char, Character>(c, character));
-    }
-
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
+    // Background cells reach down to the deepest ASCII descender. SDF
+    // bitmaps carry the spread as padding, which doesn't count.
+    int descent = 0;
+    for (size_t c = 0; c < m_AsciiGlyphs.size(); ++c) {
+        if (m_AsciiLoaded.test(c) && m_AsciiGlyphs[c].Size.y > 0) {
+            descent = std::max(descent, m_AsciiGlyphs[c].Size.y - m_AsciiGlyphs[c].Bearing.y);
+        }
+    }
+    m_CellDescent = std::max(0.0f, static_cast<float>(descent) - GetSDFSpread());
 
     std::cout << "Font loaded successfully: " << fontPath << std::endl;
     return true;
 }
 
-bool TextRenderer::CreateShaders() {
-    // Vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+bool TextRenderer::OpenFace() {
+    // Only ever tried once
+    if (m_FreeType) {
+        return m_Face != nullptr;
+    }
+
+    if (FT_Init_FreeType(&m_FreeType)) {
+        std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+        m_FreeType = nullptr;
+        return false;
+    }
+
+    // Both SDF rasterizers, from outlines and from embedded bitmaps
+    FT_Int spread = SDF_SPREAD;
+    FT_Property_Set(m_FreeType, "sdf", "spread", &spread);
+    FT_Property_Set(m_FreeType, "bsdf", "spread", &spread);
+
+    if (FT_New_Memory_Face(m_FreeType, m_FontData.data(), static_cast<FT_Long>(m_FontData.size()), 0, &m_Face)) {
+        m_Face = nullptr;
         return false;
     }
 
-    // Fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
+    FT_Set_Pixel_Sizes(m_Face, 0, m_FontHeight);
+    return true;
+}
 
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+bool TextRenderer::LoadGlyph(uint32_t codepoint, Character& character) {
+    if (m_GlyphFormat == GlyphFormat::SDF) {
+        if (FT_Load_Char(m_Face, codepoint, FT_LOAD_DEFAULT) ||
+            FT_Render_Glyph(m_Face->glyph, FT_RENDER_MODE_SDF)) {
+            return false;
+        }
+    } else if (FT_Load_Char(m_Face, codepoint, FT_LOAD_RENDER)) {
         return false;
     }
 
-    // Shader program
-    m_ShaderProgram = glCreateProgram();
-    glAttachShader(m_ShaderProgram, vertexShader);
-    glAttachShader(m_ShaderProgram, fragmentShader);
-    glLinkProgram(m_ShaderProgram);
+    const FT_Bitmap& bitmap = m_Face->glyph->bitmap;
+    character.Size = glm::ivec2(bitmap.width, bitmap.rows);
+    character.Bearing = glm::ivec2(m_Face->glyph->bitmap_left, m_Face->glyph->bitmap_top);
+    character.Advance = static_cast<unsigned int>(m_Face->glyph->advance.x);
+
+    return PlaceGlyph(codepoint, bitmap.buffer, bitmap.pitch, character);
+}
+
+bool TextRenderer::PlaceGlyph(uint32_t codepoint, const unsigned char* pixels, int pitch, Character& character) {
+    bool added = m_Atlas.AddGlyph(codepoint, pixels, pitch, character, m_Evicted);
+    for (uint32_t evicted : m_Evicted) {
+        ForgetCharacter(evicted);
+    }
+    m_Evicted.clear();
+    return added;
+}
+
+void TextRenderer::SetCharacter(uint32_t codepoint, const Character& character) {
+    if (codepoint < 128) {
+        m_AsciiGlyphs[codepoint] = character;
+        m_AsciiLoaded.set(codepoint);
+        return;
+    }
+
+    std::unique_ptr<GlyphPage>& page = m_GlyphPages[codepoint >> 8];
+    if (!page) {
+        page = std::make_unique<GlyphPage>();
+    }
+    page->glyphs[codepoint & 0xFF] = character;
+    page->loaded.set(codepoint & 0xFF);
+}
+
+void TextRenderer::ForgetCharacter(uint32_t codepoint) {
+    if (codepoint < 128) {
+        m_AsciiLoaded.reset(codepoint);
+        return;
+    }
+
+    std::unique_ptr<GlyphPage>& page = m_GlyphPages[codepoint >> 8];
+    if (page) {
+        page->loaded.reset(codepoint & 0xFF);
+    }
+}
 
-    glGetProgramiv(m_ShaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(m_ShaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+bool TextRenderer::CreateShaders() {
+    if (!m_Shader.Create("Text", vertexShaderSource, fragmentShaderSource)) {
         return false;
     }
+    m_ProjectionLocation = m_Shader.GetUniformLocation("projection");
+    m_OffsetLocation = m_Shader.GetUniformLocation("offset");
+    m_CellMetricsLocation = m_Shader.GetUniformLocation("cellMetrics");
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // Sampler units never change, so bind them once
+    m_Shader.Use();
+    glUniform1i(m_Shader.GetUniformLocation("text"), 0);
+    glUniform1i(m_Shader.GetUniformLocation("glyphTable"), 1);
+    glUniform1i(m_Shader.GetUniformLocation("palette"), 3);
+    glUniform1f(m_Shader.GetUniformLocation("sdfSpread"), GetSDFSpread());
 
     return true;
 }
 
-void TextRenderer::RenderText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
-    glUseProgram(m_ShaderProgram);
-    glUniform3f(glGetUniformLocation(m_ShaderProgram, "textColor"), color.x, color.y, color.z);
-    glUniformMatrix4fv(glGetUniformLocation(m_ShaderProgram, "projection"), 1, GL_FALSE, &m_Projection[0][0]);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(m_VAO);
+void TextRenderer::BeginDraw(glm::vec2 offset) {
+    m_Shader.Use();
+    glUniformMatrix4fv(m_ProjectionLocation, 1, GL_FALSE, &m_Projection[0][0]);
+    glUniform2f(m_OffsetLocation, offset.x, offset.y);
+    glUniform2f(m_CellMetricsLocation, static_cast<float>(m_FontHeight), m_CellDescent);
+    GLState::BindTexture(PALETTE_UNIT, GL_TEXTURE_2D, m_PaletteTexture);
+    GLState::BindTexture(GLYPH_TABLE_UNIT, GL_TEXTURE_BUFFER, m_Atlas.GetTableTexture());
+    GLState::BindTexture(ATLAS_UNIT, GL_TEXTURE_2D, m_Atlas.GetTexture());
+    GLState::BindVertexArray(m_VAO);
+}
 
-    // Iterate through all characters
-    for (char c : text) {
-        Character ch = m_Characters[c];
+void TextRenderer::BindInstanceAttributes(unsigned int buffer, size_t offset) {
+    // GL 3.3 has no base instance, so point the attributes at the slice of
+    // the buffer being drawn instead. Expects m_VAO to be bound.
+    GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance),
+                          (void*)(offset + offsetof(GlyphInstance, x)));
+    glVertexAttribIPointer(1, 2, GL_UNSIGNED_SHORT, sizeof(GlyphInstance),
+                           (void*)(offset + offsetof(GlyphInstance, glyph)));
+    glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, sizeof(GlyphInstance),
+                           (void*)(offset + offsetof(GlyphInstance, color)));
+}
+
+void TextRenderer::ReserveBatch(size_t count) {
+    if (m_Batch && m_BatchCount + count <= m_BatchCapacity) {
+        return;
+    }
 
-        float xpos = x + ch.Bearing.x * scale;
-        float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
+    // Current mapping is full: draw it and map a fresh range
+    if (m_Batch) {
+        FlushBatch();
+    }
 
-        float w = ch.Size.x * scale;
-        float h = ch.Size.y * scale;
+    size_t capacityBytes = 0;
+    m_Batch = static_cast<GlyphInstance*>(
+        m_InstanceStream.Map(sizeof(GlyphInstance) * count, capacityBytes));
+    m_BatchCount = 0;
+    m_BatchCapacity = m_Batch ? capacityBytes / sizeof(GlyphInstance) : 0;
+}
 
-        // Update VBO for each character
-        float vertices[6][4] = {
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos,     ypos,       0.0f, 1.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
+uint8_t TextRenderer::GetPaletteIndex(const glm::vec3& color) {
+    for (size_t i = 0; i < m_Palette.size(); ++i) {
+        if (m_Palette[i] == color) {
+            return static_cast<uint8_t>(PALETTE_DYNAMIC + i);
+        }
+    }
 
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-            { xpos + w, ypos + h,   1.0f, 0.0f }
-        };
+    // Out of palette slots: draw what we have and start a fresh palette.
+    // Otherwise the palette lives until the next BeginBatch, so flushes in
+    // the middle of a frame keep earlier indices valid.
+    if (m_Palette.size() >= MAX_PALETTE_COLORS) {
+        FlushBatch();
+        m_Palette.clear();
+    }
+    m_Palette.push_back(color);
+    uint8_t slot = static_cast<uint8_t>(PALETTE_DYNAMIC + m_Palette.size() - 1);
+    SetPaletteColor(slot, color);
+    return slot;
+}
 
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+void TextRenderer::SetPaletteColor(uint8_t slot, const glm::vec3& color) {
+    uint8_t* texel = &m_PaletteData[slot * 4];
+    for (int i = 0; i < 3; ++i) {
+        uint8_t value = static_cast<uint8_t>(std::min(std::max(color[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+        if (texel[i] != value) {
+            texel[i] = value;
+            m_PaletteDirty = true;
+        }
+    }
+    texel[3] = 255;
+}
 
-        x += (ch.Advance >> 6) * scale;
+void TextRenderer::SetPaletteSRGB(bool srgb) {
+    if (srgb == m_PaletteSRGB || !m_PaletteTexture) {
+        return;
     }
+    m_PaletteSRGB = srgb;
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // Same texels, reinterpreted: the colors are authored in sRGB
+    GLState::BindTexture(PALETTE_UNIT, GL_TEXTURE_2D, m_PaletteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8, PALETTE_SIZE, 1, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, m_PaletteData.data());
+    m_PaletteDirty = false;
+}
+
+void TextRenderer::CommitGlyphs() {
+    m_Atlas.Commit();
+
+    // The whole palette is 1KB, so it always goes up in one piece
+    if (m_PaletteDirty && m_PaletteTexture) {
+        GLState::BindTexture(PALETTE_UNIT, GL_TEXTURE_2D, m_PaletteTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, PALETTE_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, m_PaletteData.data());
+        m_PaletteDirty = false;
+    }
+}
+
+void TextRenderer::BeginBatch() {
+    FlushBatch();
+    m_Palette.clear();
+    m_InstanceStream.BeginFrame();
+    m_Atlas.BeginFrame();
+
+    // Layouts cached with the fallback for a deferred glyph redo themselves
+    if (m_GlyphsDeferred) {
+        m_Atlas.Invalidate();
+        m_GlyphsDeferred = false;
+    }
+}
+
+// Whether any run paints cells behind its glyphs
+static bool HasBackground(const StyleRun* styles, size_t styleCount) {
+    for (size_t i = 0; i < styleCount; ++i) {
+        const TextStyle& style = styles[i].style;
+        if (style.background != PALETTE_BACKGROUND || (style.attributes & GLYPH_INVERSE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t TextRenderer::EmitGlyphs(const std::string& text, float x, float y, float scale,
+                                const StyleRun* styles, size_t styleCount,
+                                GlyphInstance* out, uint32_t& pageMask) {
+    uint16_t fixedScale = static_cast<uint16_t>(scale * 256.0f + 0.5f);
+    static const TextStyle defaultStyle;
+    size_t count = 0;
+
+    // Background cells go in a first pass, so no glyph overhang is ever
+    // painted over by the next character's cell
+    for (int pass = HasBackground(styles, styleCount) ? 0 : 1; pass < 2; ++pass) {
+        float penX = x;
+        size_t run = 0;
+
+        for (size_t i = 0; i < text.size();) {
+            while (run < styleCount && styles[run].start <= i) {
+                ++run;
+            }
+            const TextStyle& style = run > 0 ? styles[run - 1].style : defaultStyle;
+            const Character& ch = ResolveCharacter(NextCodepoint(text, i));
+            unsigned int advance = ch.Advance >> 6;
+
+            bool cell = pass == 0;
+            if (cell ? (style.background != PALETTE_BACKGROUND || (style.attributes & GLYPH_INVERSE))
+                     : (ch.Size.x > 0 && ch.Size.y > 0)) {
+                // Touch right away so loading a later glyph can't evict this one
+                if (!cell) {
+                    pageMask |= m_Atlas.Touch(ch.Index);
+                }
+
+                GlyphInstance& instance = out[count++];
+                instance.x = penX;
+                instance.y = y;
+                instance.glyph = cell ? 0 : static_cast<uint16_t>(ch.Index);
+                instance.scale = fixedScale;
+                instance.color = style.foreground;
+                instance.attr = cell ? (style.attributes | GLYPH_CELL) : style.attributes;
+                instance.background = style.background;
+                instance.width = static_cast<uint8_t>(std::min(advance, 255u));
+            }
+
+            penX += advance * scale;
+        }
+    }
+
+    return count;
+}
+
+void TextRenderer::QueueText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
+    StyleRun run = { 0, TextStyle() };
+    run.style.foreground = GetPaletteIndex(color);
+
+    // Instances are written straight into mapped stream memory. A UTF-8
+    // string never has more code points than bytes.
+    ReserveBatch(text.size());
+    if (!m_Batch) {
+        return;
+    }
+
+    uint32_t pageMask = 0;
+    m_BatchCount += EmitGlyphs(text, x, y, scale, &run, 1, m_Batch + m_BatchCount, pageMask);
+}
+
+void TextRenderer::QueueText(const std::string& text, float x, float y, float scale, const std::vector<StyleRun>& styles) {
+    // Room for a background cell behind every character as well
+    ReserveBatch(HasBackground(styles.data(), styles.size()) ? text.size() * 2 : text.size());
+    if (!m_Batch) {
+        return;
+    }
+
+    uint32_t pageMask = 0;
+    m_BatchCount += EmitGlyphs(text, x, y, scale, styles.data(), styles.size(),
+                               m_Batch + m_BatchCount, pageMask);
+}
+
+void TextRenderer::FlushBatch() {
+    size_t count = m_BatchCount;
+    size_t offset = 0;
+    if (m_Batch) {
+        offset = m_InstanceStream.Unmap(sizeof(GlyphInstance) * count);
+        m_Batch = nullptr;
+        m_BatchCount = 0;
+        m_BatchCapacity = 0;
+    }
+
+    if (count == 0 && m_QueuedMeshes.empty()) {
+        return;
+    }
+
+    // Glyphs rasterized and colors added while queueing go up in a single
+    // upload, before anything that references them is drawn
+    CommitGlyphs();
+
+    for (const auto& queued : m_QueuedMeshes) {
+        DrawMesh(*queued.first, queued.second);
+    }
+    m_QueuedMeshes.clear();
+
+    if (count > 0) {
+        BeginDraw(glm::vec2(0.0f));
+        BindInstanceAttributes(m_InstanceStream.GetBuffer(), offset);
+        GLState::DrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<GLsizei>(count));
+    }
+}
+
+uint32_t TextRenderer::LayoutText(const std::string& text, float scale, const std::vector<StyleRun>& styles,
+                                  std::vector<GlyphInstance>& out) {
+    uint32_t pageMask = 0;
+    out.resize(HasBackground(styles.data(), styles.size()) ? text.size() * 2 : text.size());
+    out.resize(EmitGlyphs(text, 0.0f, 0.0f, scale, styles.data(), styles.size(), out.data(), pageMask));
+    return pageMask;
+}
+
+void TextRenderer::QueueMesh(TextMesh& mesh, glm::vec2 offset) {
+    if (mesh.GetInstanceCount() == 0) {
+        return;
+    }
+
+    m_Atlas.TouchPages(mesh.GetGlyphPages());
+    m_QueuedMeshes.emplace_back(&mesh, offset);
+}
+
+void TextRenderer::DrawMesh(TextMesh& mesh, glm::vec2 offset) {
+    size_t byteOffset = mesh.Sync();
+
+    BeginDraw(offset);
+    BindInstanceAttributes(mesh.GetBuffer(), byteOffset);
+    GLState::DrawArraysInstanced(GL_TRIANGLES, 0, 6, static_cast<GLsizei>(mesh.GetInstanceCount()));
+}
+
+void TextRenderer::RenderText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
+    QueueText(text, x, y, scale, color);
+    FlushBatch();
 }
 
 void TextRenderer::UpdateProjection(unsigned int width, unsigned int height) {
+    m_ScreenSize = glm::vec2(static_cast<float>(width), static_cast<float>(height));
     m_Projection = glm::ortho(0.0f, static_cast<float>(width), 0.0f, static_cast<float>(height));
 }
 
-unsigned int TextRenderer::GetCharWidth(char c) const {
-    auto it = m_Characters.find(c);
-    if (it != m_Characters.end()) {
-        return (it->second.Advance >> 6);
+const Character& TextRenderer::GetCharacter(uint32_t codepoint) const {
+    if (codepoint < 128) {
+        return m_AsciiLoaded.test(codepoint) ? m_AsciiGlyphs[codepoint] : m_FallbackGlyph;
+    }
+
+    uint32_t page = codepoint >> 8;
+    if (page < m_GlyphPages.size() && m_GlyphPages[page]) {
+        const GlyphPage& glyphPage = *m_GlyphPages[page];
+        if (glyphPage.loaded.test(codepoint & 0xFF)) {
+            return glyphPage.glyphs[codepoint & 0xFF];
+        }
+    }
+    return m_FallbackGlyph;
+}
+
+const Character& TextRenderer::ResolveCharacter(uint32_t codepoint) {
+    // ASCII is loaded at startup and pinned
+    if (codepoint < 128 || codepoint >= 0x110000) {
+        return GetCharacter(codepoint);
+    }
+
+    const GlyphPage* page = m_GlyphPages[codepoint >> 8].get();
+    if (page && page->loaded.test(codepoint & 0xFF)) {
+        return page->glyphs[codepoint & 0xFF];
+    }
+
+    // The atlas already went up this frame, e.g. after a mid-frame flush;
+    // rasterize next frame so there is still one upload per frame
+    if (m_Atlas.IsCommitted()) {
+        m_GlyphsDeferred = true;
+        return m_FallbackGlyph;
+    }
+
+    if (!OpenFace()) {
+        return m_FallbackGlyph;
     }
-    return 0;
+
+    // Code points the font lacks are remembered as the fallback glyph, so
+    // they are only looked up once
+    Character character = m_FallbackGlyph;
+    if (FT_Get_Char_Index(m_Face, codepoint) != 0 && !LoadGlyph(codepoint, character)) {
+        // No room: every evictable page is in use this frame. Try again later.
+        return m_FallbackGlyph;
+    }
+
+    SetCharacter(codepoint, character);
+    return m_GlyphPages[codepoint >> 8]->glyphs[codepoint & 0xFF];
+}
+
+uint32_t TextRenderer::NextCodepoint(const std::string& text, size_t& index) {
+    unsigned char lead = static_cast<unsigned char>(text[index++]);
+    if (lead < 0x80) {
+        return lead;
+    }
+
+    size_t extra;
+    uint32_t codepoint, minimum;
+    if ((lead & 0xE0) == 0xC0) {
+        extra = 1; codepoint = lead & 0x1F; minimum = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        extra = 2; codepoint = lead & 0x0F; minimum = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        extra = 3; codepoint = lead & 0x07; minimum = 0x10000;
+    } else {
+        return REPLACEMENT_CHARACTER;
+    }
+
+    if (index + extra > text.size()) {
+        return REPLACEMENT_CHARACTER;
+    }
+    for (size_t i = 0; i < extra; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[index + i]);
+        if ((c & 0xC0) != 0x80) {
+            // Resynchronize on the offending byte
+            return REPLACEMENT_CHARACTER;
+        }
+        codepoint = (codepoint << 6) | (c & 0x3F);
+    }
+    index += extra;
+
+    // Overlong forms, surrogates and values past Unicode are malformed too
+    if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        return REPLACEMENT_CHARACTER;
+    }
+    return codepoint;
+}
+
+float TextRenderer::GetSDFSpread() const {
+    return m_GlyphFormat == GlyphFormat::SDF ? static_cast<float>(SDF_SPREAD) : 0.0f;
+}
+
+unsigned int TextRenderer::GetCharWidth(char c) const {
+    return GetCharacter(static_cast<unsigned char>(c)).Advance >> 6;
 }
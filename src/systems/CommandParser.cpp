@@ -3,7 +3,9 @@
 #include "systems/FileSystem.h"
 #include "ui/Terminal.h"
 #include "rendering/CRTShader.h"
+#include "rendering/GLState.h"
 #include <sstream>
+#include <iomanip>
 #include <algorithm>
 #include <ctime>
 
@@ -36,8 +38,16 @@ void CommandParser::Initialize() {
         "change terminal text color");
     RegisterCommand("crt", [this](const auto& args) { CmdCRT(args); }, 
         "toggle or adjust CRT effect");
+    RegisterCommand("render", [this](const auto& args) { CmdRender(args); }, 
+        "switch terminal render mode");
+    RegisterCommand("stats", [this](const auto& args) { CmdStats(args); }, 
+        "show renderer statistics");
     RegisterCommand("speed", [this](const auto& args) { CmdSpeed(args); }, 
         "adjust typewriter text speed");
+    RegisterCommand("fps", [this](const auto& args) { CmdFps(args); }, 
+        "set the frame rate limit");
+    RegisterCommand("pacing", [this](const auto& args) { CmdPacing(args); }, 
+        "frame pacing and input latency");
     RegisterCommand("save", [this](const auto& args) { CmdSave(args); }, 
         "save current game state");
 }
@@ -152,8 +162,15 @@ void CommandParser::CmdCRT(const std::vector<std::string>& args) {
         m_Terminal->AddLine("  crt curve <n>     - Screen curvature (0.0-1.0)");
         m_Terminal->AddLine("  crt vignette <n>  - Vignette strength (0.0-1.0)");
         m_Terminal->AddLine("  crt glow <n>      - Glow intensity (0.0-1.0)");
+        m_Terminal->AddLine("  crt glow passes <n> - Glow blur passes (1-4)");
+        m_Terminal->AddLine("  crt glow res <n>  - Glow blur resolution divisor (2, 4, 8, 16)");
         m_Terminal->AddLine("  crt noise <n>     - Noise amount (0.0-1.0)");
         m_Terminal->AddLine("  crt chroma <n>    - Chromatic aberration (0.0-2.0)");
+        m_Terminal->AddLine("  crt persistence <n> - Phosphor afterglow (0.0-0.95)");
+        m_Terminal->AddLine("  crt quality <n>   - Render resolution % (50-100), or auto");
+        m_Terminal->AddLine("  crt resolution <w>x<h> - Fixed virtual resolution, or native");
+        m_Terminal->AddLine("  crt format <f>    - Target format: rgba8, rgb10a2 or srgb");
+        m_Terminal->AddLine("  crt bench         - Time curvature/vignette, LUT vs per pixel");
         m_Terminal->AddLine("");
         m_Terminal->AddLine("Current: " + std::string(m_CRTShader->IsEnabled() ? "ON" : "OFF"));
         m_Terminal->AddLine("");
@@ -171,6 +188,106 @@ void CommandParser::CmdCRT(const std::vector<std::string>& args) {
         m_CRTShader->SetEnabled(false);
         m_Terminal->AddLine("CRT effect disabled");
     }
+    else if (option == "bench") {
+        // Curvature + vignette pass at common monitor sizes, both paths
+        static const unsigned int sizes[][2] = {{1920, 1080}, {3840, 2160}};
+        m_Terminal->AddLine("Curvature + vignette, GPU ms per frame:");
+        for (const auto& size : sizes) {
+            double lut = 0.0, direct = 0.0;
+            std::ostringstream line;
+            line << "  " << size[0] << "x" << size[1] << "  ";
+            if (m_CRTShader->Benchmark(size[0], size[1], lut, direct)) {
+                line << std::fixed << std::setprecision(3) << "LUT " << lut << "  per pixel " << direct;
+            } else {
+                line << "unavailable";
+            }
+            m_Terminal->AddLine(line.str());
+        }
+    }
+    else if (option == "resolution") {
+        if (args.size() < 3) {
+            if (m_CRTShader->HasVirtualResolution()) {
+                m_Terminal->AddLine("Resolution: " + std::to_string(m_CRTShader->GetVirtualWidth()) + "x" +
+                                    std::to_string(m_CRTShader->GetVirtualHeight()));
+            } else {
+                m_Terminal->AddLine("Resolution: native");
+            }
+        }
+        else if (!m_Engine) {
+            m_Terminal->AddLine("Error: Engine not available");
+        }
+        else if (args[2] == "native") {
+            m_Engine->SetVirtualResolution(0, 0);
+            m_Terminal->AddLine("Resolution set to native");
+        }
+        else {
+            // <width>x<height>, e.g. 800x600
+            unsigned int width = 0, height = 0;
+            char separator = 0;
+            std::istringstream size(args[2]);
+            if (size >> width >> separator >> height && (separator == 'x' || separator == 'X') &&
+                width >= 320 && height >= 200 && width <= 3840 && height <= 2160) {
+                m_Engine->SetVirtualResolution(width, height);
+                m_Terminal->AddLine("Resolution set to " + std::to_string(width) + "x" + std::to_string(height));
+            } else {
+                m_Terminal->AddLine("Error: Expected <width>x<height> between 320x200 and 3840x2160");
+            }
+        }
+    }
+    else if (option == "format") {
+        if (args.size() < 3) {
+            m_Terminal->AddLine("Format: " + std::string(m_CRTShader->GetColorFormatName()));
+        }
+        else if (m_CRTShader->SetColorFormat(args[2])) {
+            m_Terminal->AddLine("Format set to " + args[2]);
+        }
+        else {
+            m_Terminal->AddLine("Error: Expected rgba8, rgb10a2 or srgb (srgb needs an sRGB window)");
+        }
+    }
+    else if (option == "quality") {
+        if (args.size() < 3) {
+            std::ostringstream status;
+            status << "Quality: " << (m_CRTShader->IsAutoQuality() ? "auto" : "manual") << ", "
+                   << static_cast<int>(m_CRTShader->GetRenderScale() * 100.0f + 0.5f) << "% resolution, "
+                   << std::fixed << std::setprecision(2) << m_CRTShader->GetGPUTime() << " ms GPU";
+            m_Terminal->AddLine(status.str());
+        }
+        else if (args[2] == "auto") {
+            m_CRTShader->SetAutoQuality(true);
+            m_Terminal->AddLine("Quality set to auto");
+        }
+        else {
+            try {
+                int percent = std::stoi(args[2]);
+                m_CRTShader->SetRenderScale(percent / 100.0f);
+                m_Terminal->AddLine("Quality set to " +
+                    std::to_string(static_cast<int>(m_CRTShader->GetRenderScale() * 100.0f + 0.5f)) + "% resolution");
+            } catch (...) {
+                m_Terminal->AddLine("Error: Invalid value");
+            }
+        }
+    }
+    else if (option == "glow" && args.size() >= 4 && (args[2] == "passes" || args[2] == "res")) {
+        try {
+            int value = std::stoi(args[3]);
+            if (value < 1) value = 1;
+            
+            bool ok;
+            if (args[2] == "passes") {
+                ok = m_CRTShader->SetGlowPasses(static_cast<unsigned int>(value));
+                m_Terminal->AddLine("Glow passes set to " + std::to_string(m_CRTShader->GetGlowPasses()));
+            } else {
+                ok = m_CRTShader->SetGlowDownsample(static_cast<unsigned int>(value));
+                m_Terminal->AddLine("Glow resolution set to 1/" + std::to_string(m_CRTShader->GetGlowDownsample()));
+            }
+            if (!ok) {
+                m_Terminal->AddLine("Error: Out of video memory for the glow blur; glow is off");
+            }
+        } catch (...) {
+            m_Terminal->AddLine("Error: Invalid value");
+        }
+    }
     else if (args.size() >= 3) {
         try {
             float value = std::stof(args[2]);
@@ -199,6 +316,10 @@ void CommandParser::CmdCRT(const std::vector<std::string>& args) {
                 m_CRTShader->SetChromaticAberration(value);
                 m_Terminal->AddLine("Chromatic aberration set to " + std::to_string(value));
             }
+            else if (option == "persistence") {
+                m_CRTShader->SetPersistence(value);
+                m_Terminal->AddLine("Phosphor persistence set to " + std::to_string(m_CRTShader->GetPersistence()));
+            }
             else {
                 m_Terminal->AddLine("Unknown CRT option: " + option);
             }
@@ -213,6 +334,96 @@ void CommandParser::CmdCRT(const std::vector<std::string>& args) {
     m_Terminal->AddLine("");
 }
 
+void CommandParser::CmdRender(const std::vector<std::string>& args) {
+    m_Terminal->AddLine("");
+    
+    if (args.size() < 2) {
+        m_Terminal->AddLine("Usage: render <batch|grid>");
+        m_Terminal->AddLine("       render glyphs <bitmap|sdf>");
+        m_Terminal->AddLine("");
+        m_Terminal->AddLine("  batch  - Instanced glyphs with cached lines (default)");
+        m_Terminal->AddLine("  grid   - Full-screen character cell pass");
+        m_Terminal->AddLine("  glyphs - bitmap is crisp at 1x (default), sdf stays sharp when scaled;");
+        m_Terminal->AddLine("           applies on the next launch");
+        m_Terminal->AddLine("");
+        bool isGrid = m_Terminal->GetRenderMode() == TerminalRenderMode::CELL_GRID;
+        m_Terminal->AddLine("Current: " + std::string(isGrid ? "grid" : "batch"));
+        if (m_Engine) {
+            bool isSDF = m_Engine->GetGlyphFormat() == GlyphFormat::SDF;
+            m_Terminal->AddLine("Glyphs:  " + std::string(isSDF ? "sdf" : "bitmap"));
+        }
+        m_Terminal->AddLine("");
+        return;
+    }
+    
+    std::string mode = args[1];
+    std::transform(mode.begin(), mode.end(), mode.begin(), ::tolower);
+    
+    if (mode == "glyphs") {
+        std::string format = args.size() > 2 ? args[2] : "";
+        std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+        if (!m_Engine) {
+            m_Terminal->AddLine("Error: Engine not available");
+        }
+        else if (format == "bitmap" || format == "sdf") {
+            m_Engine->SetGlyphFormat(format == "sdf" ? GlyphFormat::SDF : GlyphFormat::BITMAP);
+            m_Terminal->AddLine("Glyph format set to " + format + "; restart to apply");
+        }
+        else {
+            m_Terminal->AddLine("Usage: render glyphs <bitmap|sdf>");
+        }
+    }
+    else if (mode == "batch") {
+        m_Terminal->SetRenderMode(TerminalRenderMode::BATCHED);
+        m_Terminal->AddLine("Render mode set to batch");
+    }
+    else if (mode == "grid") {
+        m_Terminal->SetRenderMode(TerminalRenderMode::CELL_GRID);
+        m_Terminal->AddLine("Render mode set to grid");
+    }
+    else {
+        m_Terminal->AddLine("Unknown render mode: " + mode);
+    }
+    
+    m_Terminal->AddLine("");
+}
+
+void CommandParser::CmdStats(const std::vector<std::string>& /*args*/) {
+    const GLState::Counters& frame = GLState::GetLastFrame();
+    
+    m_Terminal->AddLine("");
+    m_Terminal->AddLine("Last frame:");
+    m_Terminal->AddLine("  draw calls     " + std::to_string(frame.drawCalls));
+    m_Terminal->AddLine("  state changes  " + std::to_string(frame.stateCalls));
+    m_Terminal->AddLine("  skipped binds  " + std::to_string(frame.skippedCalls));
+    if (m_Engine) {
+        const FrameScheduler& scheduler = m_Engine->GetFrameScheduler();
+        std::ostringstream rate;
+        rate << "  frame rate     " << std::fixed << std::setprecision(1) << scheduler.GetFrameRate()
+             << " fps (limit " << scheduler.GetTargetFPS() << ")";
+        m_Terminal->AddLine(rate.str());
+        const FramePacer& pacer = m_Engine->GetFramePacer();
+        std::ostringstream latency;
+        latency << "  key to swap    " << std::fixed << std::setprecision(1) << pacer.GetMeanLatency()
+                << " ms mean (" << pacer.GetSampleCount() << " presses, see pacing)";
+        m_Terminal->AddLine(latency.str());
+    }
+    if (m_CRTShader) {
+        std::ostringstream variant;
+        variant << "  crt variant    0x" << std::hex << m_CRTShader->GetEffectMask() << std::dec
+                << " (" << m_CRTShader->GetVariantCount() << " compiled)";
+        m_Terminal->AddLine(variant.str());
+        m_Terminal->AddLine("  crt passes     " + std::to_string(m_CRTShader->GetPassCount()) +
+                            " (" + m_CRTShader->GetPassNames() + ")");
+        std::ostringstream quality;
+        quality << "  crt quality    " << static_cast<int>(m_CRTShader->GetRenderScale() * 100.0f + 0.5f) << "% "
+                << (m_CRTShader->IsAutoQuality() ? "auto" : "manual") << ", "
+                << std::fixed << std::setprecision(2) << m_CRTShader->GetGPUTime() << " ms GPU";
+        m_Terminal->AddLine(quality.str());
+    }
+    m_Terminal->AddLine("");
+}
+
 void CommandParser::CmdSpeed(const std::vector<std::string>& args) {
     m_Terminal->AddLine("");
     
@@ -241,6 +452,125 @@ void CommandParser::CmdSpeed(const std::vector<std::string>& args) {
     m_Terminal->AddLine("");
 }
 
+void CommandParser::CmdFps(const std::vector<std::string>& args) {
+    m_Terminal->AddLine("");
+    
+    if (!m_Engine) {
+        m_Terminal->AddLine("Error: Engine not available");
+        m_Terminal->AddLine("");
+        return;
+    }
+    FrameScheduler& scheduler = m_Engine->GetFrameScheduler();
+    
+    if (args.size() < 2) {
+        m_Terminal->AddLine("Usage: fps <frames per second>");
+        m_Terminal->AddLine("Frames are only drawn when something changes, at most this often.");
+        m_Terminal->AddLine("CRT animation drops to " + std::to_string(FrameScheduler::IDLE_FPS) +
+                            " fps after " + std::to_string(static_cast<int>(FrameScheduler::IDLE_DELAY)) +
+                            " s without input.");
+        m_Terminal->AddLine("Current: " + std::to_string(scheduler.GetTargetFPS()));
+        m_Terminal->AddLine("");
+        return;
+    }
+    
+    try {
+        int fps = std::stoi(args[1]);
+        scheduler.SetTargetFPS(static_cast<unsigned int>(std::max(fps, 1)));
+        m_Terminal->AddLine("Frame rate limit set to " + std::to_string(scheduler.GetTargetFPS()) + " fps");
+    } catch (...) {
+        m_Terminal->AddLine("Error: Invalid frame rate");
+    }
+    
+    m_Terminal->AddLine("");
+}
+
+void CommandParser::CmdPacing(const std::vector<std::string>& args) {
+    m_Terminal->AddLine("");
+    
+    if (!m_Engine) {
+        m_Terminal->AddLine("Error: Engine not available");
+        m_Terminal->AddLine("");
+        return;
+    }
+    FramePacer& pacer = m_Engine->GetFramePacer();
+    
+    std::string option = args.size() >= 2 ? args[1] : "";
+    std::transform(option.begin(), option.end(), option.begin(), ::tolower);
+    
+    if (option == "vsync" || option == "frames") {
+        try {
+            int value = std::stoi(args.at(2));
+            if (option == "vsync") {
+                pacer.SetSwapInterval(value);
+                m_Terminal->AddLine("Swap interval set to " + std::to_string(pacer.GetSwapInterval()));
+            } else {
+                pacer.SetMaxFramesInFlight(static_cast<unsigned int>(std::max(value, 0)));
+                m_Terminal->AddLine("Frames in flight set to " + std::to_string(pacer.GetMaxFramesInFlight()));
+            }
+            pacer.ResetHistogram();  // Samples from the old mode would mix in
+        } catch (...) {
+            m_Terminal->AddLine("Error: Invalid value");
+        }
+    }
+    else if (option == "latency") {
+        // Wait for each frame to finish before reading input for the next
+        pacer.SetSwapInterval(1);
+        pacer.SetMaxFramesInFlight(1);
+        pacer.ResetHistogram();
+        m_Terminal->AddLine("Pacing set to latency: vsync 1, 1 frame in flight");
+    }
+    else if (option == "default") {
+        pacer.SetSwapInterval(1);
+        pacer.SetMaxFramesInFlight(0);
+        pacer.ResetHistogram();
+        m_Terminal->AddLine("Pacing set to default: vsync 1, driver frame queue");
+    }
+    else if (option == "reset") {
+        pacer.ResetHistogram();
+        m_Terminal->AddLine("Latency histogram cleared");
+    }
+    else if (!option.empty()) {
+        m_Terminal->AddLine("Usage: pacing [vsync <0-2> | frames <0-3> | latency | default | reset]");
+    }
+    else {
+        m_Terminal->AddLine("Swap interval: " + std::to_string(pacer.GetSwapInterval()) +
+                            ", frames in flight: " + (pacer.GetMaxFramesInFlight() ?
+                                std::to_string(pacer.GetMaxFramesInFlight()) : std::string("driver")));
+        
+        std::ostringstream summary;
+        summary << "Key to swap, " << pacer.GetSampleCount() << " presses";
+        if (pacer.GetSampleCount() > 0) {
+            summary << std::fixed << std::setprecision(1) << " (mean " << pacer.GetMeanLatency()
+                    << " ms, max " << pacer.GetMaxLatency() << " ms)";
+        }
+        m_Terminal->AddLine(summary.str() + ":");
+        
+        // One bar per bucket, scaled to the fullest
+        static const unsigned int BAR_WIDTH = 30;
+        unsigned int fullest = 0;
+        for (unsigned int i = 0; i < FramePacer::BUCKET_COUNT; ++i) {
+            fullest = std::max(fullest, pacer.GetBucketCount(i));
+        }
+        for (unsigned int i = 0; i < FramePacer::BUCKET_COUNT; ++i) {
+            std::ostringstream range;
+            range << std::setprecision(3) << (i > 0 ? FramePacer::GetBucketLimit(i - 1) : 0.0);
+            if (i + 1 < FramePacer::BUCKET_COUNT) {
+                range << "-" << FramePacer::GetBucketLimit(i);
+            } else {
+                range << "+";
+            }
+            unsigned int count = pacer.GetBucketCount(i);
+            unsigned int bar = fullest ? (count * BAR_WIDTH + fullest - 1) / fullest : 0;
+            std::ostringstream line;
+            line << "  " << std::setw(9) << range.str() << " ms  " << std::left << std::setw(BAR_WIDTH)
+                 << std::string(bar, '#') << std::right << " " << count;
+            m_Terminal->AddLine(line.str());
+        }
+    }
+    
+    m_Terminal->AddLine("");
+}
+
 void CommandParser::CmdRm(const std::vector<std::string>& args) {
     m_Terminal->AddLine("");
     
@@ -62,7 +62,7 @@ void AsciiArt::RenderDirect(TextRenderer* renderer, float x, float y, float scal
     float currentY = y;
     
     for (const auto& line : m_Lines) {
-        renderer->RenderText(line, x, currentY, scale, color);
+        renderer->QueueText(line, x, currentY, scale, color);
         currentY -= lineHeight;
     }
 }
@@ -81,7 +81,7 @@ void AsciiArt::RenderCachedDirect(const std::string& name, TextRenderer* rendere
     float currentY = y;
     
     for (const auto& line : *lines) {
-        renderer->RenderText(line, x, currentY, scale, color);
+        renderer->QueueText(line, x, currentY, scale, color);
         currentY -= lineHeight;
     }
 }
@@ -1,23 +1,157 @@
 #include "ui/Terminal.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
 #include <glm/glm.hpp>
 
+// Apply the parameters of one SGR sequence (the part between "ESC[" and
+// "m") to a style. Unsupported parameters are ignored.
+static void ApplySGR(const std::string& params, TextStyle& style) {
+    std::vector<int> codes;
+    size_t start = 0;
+    while (start <= params.size()) {
+        size_t end = params.find(';', start);
+        if (end == std::string::npos) {
+            end = params.size();
+        }
+        // An empty parameter means 0
+        codes.push_back(std::atoi(params.substr(start, end - start).c_str()));
+        start = end + 1;
+    }
+
+    for (size_t i = 0; i < codes.size(); ++i) {
+        int code = codes[i];
+        if (code == 0) {
+            style = TextStyle();
+        } else if (code == 1) {
+            style.attributes |= GLYPH_BOLD;
+        } else if (code == 2) {
+            style.attributes |= GLYPH_DIM;
+        } else if (code == 7) {
+            style.attributes |= GLYPH_INVERSE;
+        } else if (code == 22) {
+            style.attributes &= ~(GLYPH_BOLD | GLYPH_DIM);
+        } else if (code == 27) {
+            style.attributes &= ~GLYPH_INVERSE;
+        } else if (code >= 30 && code <= 37) {
+            style.foreground = static_cast<uint8_t>(PALETTE_ANSI + code - 30);
+        } else if (code == 39) {
+            style.foreground = PALETTE_FOREGROUND;
+        } else if (code >= 40 && code <= 47) {
+            style.background = static_cast<uint8_t>(PALETTE_ANSI + code - 40);
+        } else if (code == 49) {
+            style.background = PALETTE_BACKGROUND;
+        } else if (code >= 90 && code <= 97) {
+            style.foreground = static_cast<uint8_t>(PALETTE_ANSI + 8 + code - 90);
+        } else if (code >= 100 && code <= 107) {
+            style.background = static_cast<uint8_t>(PALETTE_ANSI + 8 + code - 100);
+        } else if ((code == 38 || code == 48) && i + 1 < codes.size()) {
+            // 256-color and true color: only the 16 ANSI entries map onto
+            // the palette, the rest is skipped over
+            if (codes[i + 1] == 5 && i + 2 < codes.size()) {
+                int index = codes[i + 2];
+                if (index >= 0 && index < 16) {
+                    uint8_t slot = static_cast<uint8_t>(PALETTE_ANSI + index);
+                    (code == 38 ? style.foreground : style.background) = slot;
+                }
+                i += 2;
+            } else if (codes[i + 1] == 2) {
+                i += 4;
+            }
+        }
+    }
+}
+
+// Strip escape sequences from a line, turning SGR ones into style runs
+static void ParseEscapes(const std::string& line, std::string& text, std::vector<StyleRun>& styles) {
+    text.clear();
+    styles.clear();
+    TextStyle style;
+
+    for (size_t i = 0; i < line.size();) {
+        if (line[i] != '\x1b') {
+            text += line[i++];
+            continue;
+        }
+
+        // Only CSI sequences (ESC [ parameters final-byte) are understood;
+        // a lone ESC is dropped
+        if (i + 1 >= line.size() || line[i + 1] != '[') {
+            ++i;
+            continue;
+        }
+        size_t end = i + 2;
+        while (end < line.size()) {
+            // UTF-8 continuation bytes are negative as plain char
+            unsigned char byte = static_cast<unsigned char>(line[end]);
+            if (byte >= 0x40 && byte <= 0x7E) {
+                break;
+            }
+            ++end;
+        }
+        if (end >= line.size()) {
+            break;
+        }
+
+        if (line[end] == 'm') {
+            ApplySGR(line.substr(i + 2, end - i - 2), style);
+            TextStyle previous = styles.empty() ? TextStyle() : styles.back().style;
+            if (style != previous) {
+                if (!styles.empty() && styles.back().start == text.size()) {
+                    styles.back().style = style;
+                } else {
+                    styles.push_back({text.size(), style});
+                }
+            }
+        }
+        i = end + 1;
+    }
+}
+
 Terminal::Terminal(unsigned int width, unsigned int height)
     : m_Width(width), m_Height(height), m_Prompt(""), 
       m_CursorBlinkTimer(0.0f), m_CursorVisible(true),
       m_TextColor(1.0f, 0.5f, 0.0f),  // Default green
       m_IsTyping(false), m_TypewriterTimer(0.0f), 
-      m_TypewriterSpeed(50.0f), m_TypewriterIndex(0) {
-    m_MaxVisibleLines = static_cast<unsigned int>((height - PADDING_TOP * 2) / LINE_HEIGHT);
+      m_TypewriterSpeed(50.0f), m_TypewriterIndex(0),
+      m_FirstLineSeq(0), m_MeshBaseSeq(0), m_MeshStartSeq(0), m_MeshEndSeq(0),
+      m_MeshDirty(true), m_MeshGlyphGeneration(0), m_RenderMode(TerminalRenderMode::BATCHED) {
+    m_MaxVisibleLines = VisibleLinesFor(height);
 }
 
 Terminal::~Terminal() {
 }
 
 void Terminal::Initialize() {
-    m_Lines.clear();
+    Clear();
     m_CurrentInput.clear();
 }
 
+unsigned int Terminal::VisibleLinesFor(unsigned int height) const {
+    // A tiny or minimized (0 x 0) window still keeps one line
+    float lines = (static_cast<float>(height) - PADDING_TOP * 2) / LINE_HEIGHT;
+    return static_cast<unsigned int>(std::max(lines, 1.0f));
+}
+
+void Terminal::Resize(unsigned int width, unsigned int height) {
+    m_Width = width;
+    m_Height = height;
+    m_MaxVisibleLines = VisibleLinesFor(height);
+    m_MeshDirty = true;  // Lines are placed from the top edge
+}
+
+float Terminal::GetTimeUntilChange() const {
+    // The cursor is only drawn after a prompt
+    float seconds = std::numeric_limits<float>::infinity();
+    if (!m_Prompt.empty()) {
+        seconds = CURSOR_BLINK_RATE - m_CursorBlinkTimer;
+    }
+    if (m_IsTyping) {
+        seconds = std::min(seconds, 1.0f / m_TypewriterSpeed - m_TypewriterTimer);
+    }
+    return std::max(seconds, 0.0f);
+}
+
 void Terminal::Update(float deltaTime) {
     // Update cursor blink
     m_CursorBlinkTimer += deltaTime;
@@ -32,13 +166,22 @@ void Terminal::Update(float deltaTime) {
         float timePerChar = 1.0f / m_TypewriterSpeed;
         
         while (m_TypewriterTimer >= timePerChar && m_TypewriterIndex < m_TypewriterBuffer.length()) {
-            m_CurrentTypingLine += m_TypewriterBuffer[m_TypewriterIndex];
-            m_TypewriterIndex++;
+            // Reveal whole UTF-8 sequences, never half a character
+            do {
+                m_CurrentTypingLine += m_TypewriterBuffer[m_TypewriterIndex];
+                m_TypewriterIndex++;
+            } while (m_TypewriterIndex < m_TypewriterBuffer.length() &&
+                     (static_cast<unsigned char>(m_TypewriterBuffer[m_TypewriterIndex]) & 0xC0) == 0x80);
             m_TypewriterTimer -= timePerChar;
             
             // Update the last line in the buffer
             if (!m_Lines.empty()) {
-                m_Lines.back() = m_CurrentTypingLine;
+                m_Lines.back().text = m_CurrentTypingLine;
+                m_Lines.back().styles = m_TypewriterStyles;
+                m_Lines.back().dirty = true;
+                if (m_FirstLineSeq + m_Lines.size() <= m_MeshEndSeq) {
+                    m_MeshDirty = true;
+                }
             }
         }
         
@@ -46,6 +189,7 @@ void Terminal::Update(float deltaTime) {
         if (m_TypewriterIndex >= m_TypewriterBuffer.length()) {
             m_IsTyping = false;
             m_TypewriterBuffer.clear();
+            m_TypewriterStyles.clear();
             m_CurrentTypingLine.clear();
             m_TypewriterIndex = 0;
             m_TypewriterTimer = 0.0f;
@@ -56,6 +200,10 @@ void Terminal::Update(float deltaTime) {
 void Terminal::Render(TextRenderer* renderer) {
     if (!renderer) return;
 
+    // Terminal text is drawn in the default foreground slot, so a color
+    // change never needs a relayout
+    renderer->SetPaletteColor(PALETTE_FOREGROUND, m_TextColor);
+
     float y = m_Height - PADDING_TOP;
 
     // Calculate how many lines to skip (for scrolling)
@@ -64,30 +212,122 @@ void Terminal::Render(TextRenderer* renderer) {
         startLine = m_Lines.size() - (m_MaxVisibleLines - 1);
     }
 
-    // Render scrolled lines
-    for (size_t i = startLine; i < m_Lines.size(); ++i) {
-        y -= LINE_HEIGHT;
-        renderer->RenderText(m_Lines[i], PADDING_LEFT, y, 1.0f, m_TextColor);
-    }
-
-    // Render current input line with prompt
-    y -= LINE_HEIGHT;
     std::string inputLine = m_Prompt + m_CurrentInput;
     
     // Add cursor
     if (m_CursorVisible && !m_Prompt.empty()) {
         inputLine += "_";
     }
-    
-    renderer->RenderText(inputLine, PADDING_LEFT, y, 1.0f, m_TextColor);
+
+    if (m_RenderMode == TerminalRenderMode::CELL_GRID) {
+        RenderCellGrid(renderer, startLine, inputLine);
+        return;
+    }
+
+    // Settled lines come from the cached mesh. The line being typed changes
+    // every frame, so it is queued fresh along with the input line.
+    size_t cachedEnd = m_Lines.size();
+    if (m_IsTyping && cachedEnd > startLine) {
+        cachedEnd--;
+    }
+    SyncMesh(renderer, startLine, cachedEnd);
+
+    float scroll = static_cast<float>(m_FirstLineSeq + startLine - m_MeshBaseSeq) * LINE_HEIGHT;
+    renderer->QueueMesh(m_Mesh, glm::vec2(PADDING_LEFT, y - LINE_HEIGHT + scroll));
+    y -= (cachedEnd - startLine) * LINE_HEIGHT;
+
+    for (size_t i = cachedEnd; i < m_Lines.size(); ++i) {
+        y -= LINE_HEIGHT;
+        renderer->QueueText(m_Lines[i].text, PADDING_LEFT, y, 1.0f, m_Lines[i].styles);
+    }
+
+    // Render current input line with prompt
+    y -= LINE_HEIGHT;
+    renderer->QueueText(inputLine, PADDING_LEFT, y, 1.0f, std::vector<StyleRun>());
+}
+
+void Terminal::RenderCellGrid(TextRenderer* renderer, size_t startLine, const std::string& inputLine) {
+    if (!m_CellGrid) {
+        m_CellGrid = std::make_unique<CellGridRenderer>();
+        if (!m_CellGrid->Initialize()) {
+            // Fall back to the batched path for good
+            m_CellGrid.reset();
+            m_RenderMode = TerminalRenderMode::BATCHED;
+            return;
+        }
+    }
+
+    unsigned int cellWidth = std::max(1u, renderer->GetCharWidth('M'));
+    unsigned int columns = static_cast<unsigned int>((m_Width - PADDING_LEFT) / cellWidth) + 1;
+    m_CellGrid->Resize(columns, m_MaxVisibleLines);
+
+    // The input line sits in the ring slot of the next line to be added
+    uint64_t startSeq = m_FirstLineSeq + startLine;
+    for (size_t i = startLine; i < m_Lines.size(); ++i) {
+        m_CellGrid->SetRow(m_FirstLineSeq + i, m_Lines[i].text, m_Lines[i].styles, renderer);
+    }
+    m_CellGrid->SetRow(m_FirstLineSeq + m_Lines.size(), inputLine, std::vector<StyleRun>(), renderer);
+
+    unsigned int rowCount = static_cast<unsigned int>(m_Lines.size() - startLine) + 1;
+    m_CellGrid->Draw(renderer, glm::vec2(PADDING_LEFT, m_Height - PADDING_TOP), LINE_HEIGHT,
+                     startSeq, rowCount);
+}
+
+void Terminal::SyncMesh(TextRenderer* renderer, size_t startLine, size_t endLine) {
+    uint64_t startSeq = m_FirstLineSeq + startLine;
+    uint64_t endSeq = m_FirstLineSeq + endLine;
+
+    // Anything other than scrolling forward means starting over, as does the
+    // atlas evicting glyphs the mesh may use. Also rebase now and then so
+    // mesh coordinates stay small enough for float precision.
+    if (m_MeshDirty || m_MeshGlyphGeneration != renderer->GetGlyphGeneration() ||
+        startSeq < m_MeshStartSeq || endSeq < m_MeshEndSeq ||
+        startSeq > m_MeshEndSeq || startSeq - m_MeshBaseSeq > 100000) {
+        m_Mesh.Clear();
+        m_MeshBaseSeq = m_MeshStartSeq = m_MeshEndSeq = startSeq;
+        m_MeshDirty = false;
+    }
+
+    // Retire lines that scrolled off the top
+    while (m_MeshStartSeq < startSeq) {
+        m_Mesh.PopFront();
+        ++m_MeshStartSeq;
+    }
+
+    // Keep the remaining lines' glyphs resident before laying out anything
+    // new; pages only retired lines used become evictable again
+    renderer->TouchGlyphPages(m_Mesh.GetGlyphPages());
+
+    // Append lines that scrolled in, laying out only those never seen before
+    while (m_MeshEndSeq < endSeq) {
+        Line& line = m_Lines[m_MeshEndSeq - m_FirstLineSeq];
+        if (line.dirty || line.glyphGeneration != renderer->GetGlyphGeneration()) {
+            line.glyphPages = renderer->LayoutText(line.text, 1.0f, line.styles, line.glyphs);
+            line.glyphGeneration = renderer->GetGlyphGeneration();
+            line.dirty = false;
+        } else {
+            renderer->TouchGlyphPages(line.glyphPages);
+        }
+
+        float lineY = -static_cast<float>(m_MeshEndSeq - m_MeshBaseSeq) * LINE_HEIGHT;
+        m_Mesh.PushBack(line.glyphs, glm::vec2(0.0f, lineY), line.glyphPages);
+        ++m_MeshEndSeq;
+    }
+
+    // Evictions while laying out above only hit pages untouched this frame,
+    // so nothing in the mesh
+    m_MeshGlyphGeneration = renderer->GetGlyphGeneration();
 }
 
 void Terminal::AddLine(const std::string& line) {
-    m_Lines.push_back(line);
+    Line entry = {std::string(), {}, {}, true, 0, 0};
+    ParseEscapes(line, entry.text, entry.styles);
+    m_Lines.push_back(std::move(entry));
     
     // Limit history (keep last 1000 lines)
     if (m_Lines.size() > 1000) {
         m_Lines.pop_front();
+        ++m_FirstLineSeq;
     }
 }
 
@@ -108,7 +348,9 @@ void Terminal::SubmitInput() {
 }
 
 void Terminal::Clear() {
+    m_FirstLineSeq += m_Lines.size();
     m_Lines.clear();
+    m_MeshDirty = true;
 }
 
 void Terminal::SetTextColor(float r, float g, float b) {
@@ -123,12 +365,12 @@ void Terminal::AddLineWithTypewriter(const std::string& line, float charsPerSeco
     }
     
     m_IsTyping = true;
-    m_TypewriterBuffer = line;
+    ParseEscapes(line, m_TypewriterBuffer, m_TypewriterStyles);
     m_CurrentTypingLine.clear();
     m_TypewriterIndex = 0;
     m_TypewriterTimer = 0.0f;
     m_TypewriterSpeed = charsPerSecond;
     
     // Add an empty line that will be filled
-    m_Lines.push_back("");
+    AddLine("");
 }